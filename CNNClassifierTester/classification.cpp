@@ -1,4 +1,7 @@
 #include "classification.h"
+#include "../common/hash.h"
+#include "../common/preprocess.h"
+#include "../common/topk.h"
 
 #include <logger.h>
 
@@ -8,29 +11,40 @@
 namespace clf
 {
     using LL = logger::LOG_LEVEL_t;
-    auto pair_desc = [](const std::pair<size_t, float> & l, const std::pair<size_t, float> & r) { return l.second > r.second; };
 
-    bool classifier_t::init_params(const cv::CommandLineParser & cmd)
+    bool classifier_t::init_params(const cv::CommandLineParser & cmd, const std::string & prefix)
     {
         bool retval = true;
 
-        if (!cmd.has("model"))
+        if (!cmd.has(prefix + "model"))
         {
-            logger::LOG_MSG(LL::Error, "<model> must be specified.");
+            logger::LOG_MSG(LL::Error, "<" + prefix + "model> must be specified.");
             retval = false;
         }
-        params.model = cmd.get<std::string>("model");
+        params.model = cmd.get<std::string>(prefix + "model");
 
-        if (!cmd.has("weights"))
+        if (!cmd.has(prefix + "weights"))
         {
-            logger::LOG_MSG(LL::Error, "<weights> must be specified.");
+            logger::LOG_MSG(LL::Error, "<" + prefix + "weights> must be specified.");
+            retval = false;
+        }
+        params.weights = cmd.get<std::string>(prefix + "weights");
+        params.check_filename = cmd.get<int>(prefix + "filename_as_labels") == 0 ? false : true;
+        params.image_size = cmd.get<size_t>(prefix + "image_size");
+        params.replicas = std::max<size_t>(cmd.get<size_t>(prefix + "replicas"), 1u);
+        params.sweep = cmd.get<std::string>(prefix + "sweep");
+        params.sweep_step = cmd.get<float>(prefix + "sweep_step");
+        params.sweep_topk = std::max<size_t>(cmd.get<size_t>(prefix + "sweep_topk"), 1u);
+        if (!params.sweep.empty() && (params.sweep_step <= 0.f || params.sweep_step > 1.f))
+        {
+            logger::LOG_MSG(LL::Error, "Wrong value <sweep_step>=" + std::to_string(params.sweep_step) + ". Allowed values: (0, 1].");
             retval = false;
         }
-        params.weights = cmd.get<std::string>("weights");
-        params.check_filename = cmd.get<int>("filename_as_labels") == 0 ? false : true;
-        params.image_size = cmd.get<size_t>("image_size");
 
-        int classifier_mode = cmd.get<int>("classifier_mode");
+        if (cmd.get<int>(prefix + "profile_layers") != 0)
+            profiler.init(cmd.get<size_t>(prefix + "profile_warmup"));
+
+        int classifier_mode = cmd.get<int>(prefix + "classifier_mode");
         params.num_classes = (CLASSES)classifier_mode;
 
         if (classifier_mode > CLASSES::SIZE)
@@ -43,10 +57,10 @@ namespace clf
         {
             std::string id = std::to_string(i);
 
-            if (!cmd.has("classes_" + id))
+            if (!cmd.has(prefix + "classes_" + id))
                 continue;
 
-            params.filename[i] = cmd.get<std::string>("classes_" + id);
+            params.filename[i] = cmd.get<std::string>(prefix + "classes_" + id);
             if (!load_class_entries(params.filename[i], (CLASSES)i))
             {
                 logger::LOG_MSG(LL::Error, "Failed to load " + params.filename[i].string() + " file.");
@@ -58,9 +72,12 @@ namespace clf
                 continue;
 
             stat_t s(params.class_entries[i].size());
-            s.topk= std::min(cmd.get<size_t>("topk_" + id), params.class_entries[i].size());
-            s.thresh = cmd.has("classifier_threshold_" + id) ? cmd.get<float>("classifier_threshold_" + id) : 0.f;
+            s.topk= std::min(cmd.get<size_t>(prefix + "topk_" + id), params.class_entries[i].size());
+            s.thresh = cmd.has(prefix + "classifier_threshold_" + id) ? cmd.get<float>(prefix + "classifier_threshold_" + id) : 0.f;
             stat[i] = s;
+
+            if (!params.sweep.empty())
+                sweep[i] = threshold_sweep_t(params.class_entries[i].size(), params.sweep_topk);
         }
 
         return retval;
@@ -82,6 +99,8 @@ namespace clf
             params.class_entries[id].push_back(str);
         }
 
+        class_index[id].build(params.class_entries[id]);
+
         stat[id].conf = confusion_matrix(params.class_entries[id].size());
         stat[id].conf_topk = confusion_matrix(params.class_entries[id].size());
         return true;
@@ -93,16 +112,13 @@ namespace clf
         msg << "\nClassifier: \n"
             << "Model: " << params.model << '\n'
             << "Config: " << params.weights << '\n'
-            << "Num classes: " << params.num_classes;
+            << "Num classes: " << params.num_classes << '\n'
+            << "Replicas: " << params.replicas;
         logger::LOG_MSG(LL::Info, msg.str());
 
         try
         {
-            classifier = cv::dnn::readNet(params.model, params.weights);
-            classifier.setPreferableBackend(cv::dnn::DNN_BACKEND_DEFAULT);
-            classifier.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
-
-            if (classifier.empty())
+            if (!classifier.load(params.model, params.weights, params.replicas, cv::dnn::DNN_BACKEND_DEFAULT, cv::dnn::DNN_TARGET_CPU))
             {
                 logger::LOG_MSG(LL::Error, "Failed to load classifier.");
                 return false;
@@ -130,33 +146,34 @@ namespace clf
             return params.filename_parser(filename_short, gt_idx, gt_names);
 
         /* default filename format:
-        ** <class_1>[_<class_2>]_*.ext */
+        ** <class_1>[_<class_2>]_*.ext
+        ** each token is matched against the heads without a label yet, in head order */
+        std::string_view filename(filename_short);
         size_t pos = 0;
         size_t of = 0;
-        size_t substr = 0;
 
         size_t match = 0;
-        while ((of = filename_short.find('_', pos)) != std::string::npos)
-        {
-           gt_names[substr] = filename_short.substr(pos, of - pos);
-
-           bool have_match = false;
-           for (size_t class_id = 0; !have_match && class_id < params.num_classes; ++class_id)
-           {
-               for (size_t i = 0; i < params.class_entries[class_id].size(); ++i)
-                   if (params.class_entries[class_id][i] == gt_names[class_id])
-                   {
-                       gt_idx[class_id] = (int)i;
-                       ++match;
-                       have_match = true;
-                       break;
-                   }
-           }
-
-           pos = of + 1;
-
-            //if (++substr >= params.num_classes)
-            //    break;
+        while ((of = filename.find('_', pos)) != std::string_view::npos)
+        {
+            std::string_view token = filename.substr(pos, of - pos);
+
+            for (size_t class_id = 0; class_id < params.num_classes; ++class_id)
+            {
+                if (gt_idx[class_id] != -1)
+                    continue;
+
+                int idx = class_index[class_id].find(token);
+                if (idx >= 0)
+                {
+                    gt_idx[class_id] = idx;
+                    gt_names[class_id] = std::string(token);
+                    ++match;
+                    break;
+                }
+            }
+
+            pos = of + 1;
+
             if (match == params.num_classes)
                 break;
         }
@@ -210,43 +227,278 @@ namespace clf
         }
     }
 
+    void classifier_t::print_predictions() const
+    {
+        for (size_t i = 0; i < params.num_classes; ++i)
+        {
+            // without ground truth every prediction is counted on the diagonal
+            const confusion_matrix & conf = stat[i].conf;
+            std::stringstream msg;
+            msg << '\n' << outlayers_names[i] << " top-1 predictions of " << conf.size() << " objects:\n";
+            for (size_t class_id = 0; class_id < conf.classes(); ++class_id)
+            {
+                size_t count = conf.getRowSum(class_id);
+                if (!count)
+                    continue;
+
+                const std::string & name = class_id < params.class_entries[i].size() ? params.class_entries[i][class_id] : std::to_string(class_id);
+                msg << std::setw(15) << name << std::setw(10) << count << '(' << std::setprecision(3) << 100. * count / conf.size() << "%)\n";
+            }
+            logger::LOG_MSG(LL::Info, msg.str());
+        }
+    }
+
+    classifier_t::stat_shard_t & classifier_t::local_shard()
+    {
+        struct cached_t
+        {
+            const classifier_t * owner;
+            size_t generation;
+            stat_shard_t * shard;
+        };
+        thread_local std::vector<cached_t> cached;
+
+        size_t generation = shards_generation.load(std::memory_order_acquire);
+        for (auto & c : cached)
+            if (c.owner == this && c.generation == generation)
+                return *c.shard;
+
+        // first call on this thread, the shard starts with the thresholds / topk of <stat> and empty counters
+        std::unique_ptr<stat_shard_t> shard(new stat_shard_t);
+        shard->stat = stat;
+        shard->sweep = sweep;
+        for (size_t i = 0; i < params.num_classes; ++i)
+        {
+            shard->stat[i].conf = confusion_matrix(params.class_entries[i].size());
+            shard->stat[i].conf_topk = confusion_matrix(params.class_entries[i].size());
+            if (!params.sweep.empty())
+                shard->sweep[i] = threshold_sweep_t(params.class_entries[i].size(), params.sweep_topk);
+        }
+
+        stat_shard_t * ptr = shard.get();
+        {
+            std::lock_guard<std::mutex> lg(shards_mutex);
+            shards.push_back(std::move(shard));
+        }
+
+        cached.erase(std::remove_if(cached.begin(), cached.end(), [this](const cached_t & c) { return c.owner == this; }), cached.end());
+        cached.push_back(cached_t{ this, generation, ptr });
+        return *ptr;
+    }
+
+    void classifier_t::merge_stat()
+    {
+        std::lock_guard<std::mutex> lg(shards_mutex);
+        for (const auto & shard : shards)
+            for (size_t i = 0; i < params.num_classes; ++i)
+            {
+                stat[i] += shard->stat[i];
+                sweep[i] += shard->sweep[i];
+            }
+
+        shards.clear();
+        // threads still caching a merged shard register a new one
+        ++shards_generation;
+    }
+
+    void classifier_t::snapshot(clf_array<size_t> & correct, clf_array<size_t> & total) const
+    {
+        // <stat> holds what was restored on resume until merge_stat() moves the shards into it, under the same lock
+        std::lock_guard<std::mutex> lg(shards_mutex);
+        for (size_t i = 0; i < params.num_classes; ++i)
+        {
+            correct[i] = stat[i].conf.getCorrect();
+            total[i] = stat[i].conf.size();
+        }
+
+        for (const auto & shard : shards)
+            for (size_t i = 0; i < params.num_classes; ++i)
+            {
+                correct[i] += shard->correct[i].load(std::memory_order_relaxed);
+                total[i] += shard->total[i].load(std::memory_order_relaxed);
+            }
+    }
+
+    std::string classifier_t::running_accuracy() const
+    {
+        clf_array<size_t> correct;
+        clf_array<size_t> total;
+        snapshot(correct, total);
+
+        std::stringstream msg;
+        for (size_t i = 0; i < params.num_classes; ++i)
+        {
+            msg << (i ? " " : "") << outlayers_names[i] << ' ' << correct[i] << '/' << total[i];
+            if (total[i])
+                msg << '(' << std::setprecision(3) << 100. * correct[i] / total[i] << "%)";
+        }
+        return msg.str();
+    }
+
+    bool classifier_t::save_sweep() const
+    {
+        if (params.sweep.empty())
+            return true;
+
+        path classes_file = params.sweep.parent_path() / (params.sweep.stem().string() + "_classes.csv");
+        std::ofstream summary(params.sweep.string());
+        std::ofstream per_class(classes_file.string());
+        if (!summary.is_open() || !per_class.is_open())
+        {
+            logger::LOG_MSG(LL::Error, "Failed to open " + params.sweep.string() + " or " + classes_file.string());
+            return false;
+        }
+
+        std::vector<float> thresholds;
+        for (int i = 0; i * params.sweep_step <= 1.f + 1e-6f; ++i)
+            thresholds.push_back(i * params.sweep_step);
+
+        threshold_sweep_t::write_csv_header(summary, per_class);
+        for (size_t i = 0; i < params.num_classes; ++i)
+            sweep[i].write_csv(summary, per_class, outlayers_names[i], thresholds, params.class_entries[i]);
+
+        logger::LOG_MSG(LL::Info, "Threshold sweep is saved to " + params.sweep.string() + " and " + classes_file.string());
+        return true;
+    }
+
     void classifier_t::process_file(const path & file, const cv::Mat & img, clf_res_t & result)
     {
-        cv::Mat crBlob = cv::dnn::blobFromImage(img,
-            params.scale_factor,
-            cv::Size((int)params.image_size, (int)params.image_size),
-            params.mean,
-            params.swap_RB,
-            params.crop,
-            params.ddepth);
+        std::vector<clf_res_t> results(1);
+        process_batch({ file }, { img }, results);
+        result = results[0];
+    }
+
+    void classifier_t::process_batch(const std::vector<path> & files, const std::vector<cv::Mat> & imgs, std::vector<clf_res_t> & results)
+    {
+        if (imgs.empty())
+            return;
 
         std::vector<cv::Mat> out;
+        forward_batch(imgs, out);
+
+        results.resize(imgs.size());
+        std::vector<cv::Mat> scores(out.size());
+        for (int i = 0; i < (int)imgs.size(); ++i)
+        {
+            for (size_t class_id = 0; class_id < out.size(); ++class_id)
+                scores[class_id] = out[class_id].row(i);
 
-        classifier.setInput(crBlob);
-        classifier.forward(out, outlayers_names);
+            process_output(files[i], scores, results[i]);
+        }
+    }
+
+    void classifier_t::forward_batch(const std::vector<cv::Mat> & imgs, std::vector<cv::Mat> & out)
+    {
+        cmn::preprocess_param_t pre;
+        pre.size = cv::Size((int)params.image_size, (int)params.image_size);
+        pre.scale_factor = params.scale_factor;
+        pre.mean = params.mean;
+        pre.swap_RB = params.swap_RB;
+        pre.crop = params.crop;
+        pre.ddepth = params.ddepth;
+
+        // reused by every batch processed on this thread
+        thread_local cv::Mat crBlob;
+        {
+            cmn::stage_timers_t::scope_t t(timers, preprocess_stage);
+            cmn::blob_from_images(imgs, crBlob, pre);
+        }
+
+        {
+            // includes waiting for a free replica
+            cmn::stage_timers_t::scope_t t(timers, forward_stage);
+            auto lease = classifier.acquire();
+            lease.net().setInput(crBlob);
+            lease.net().forward(out, outlayers_names);
+            if (profiler.enabled())
+                profiler.add(lease.net(), lease.id(), imgs.size());
+
+            // output blobs share memory with the replica, copy them before it is released
+            for (auto & o : out)
+                o = o.clone();
+        }
+
+        // every output layer is [batch, num_classes(, 1, 1)]
+        for (auto & o : out)
+            o = o.reshape(1, (int)imgs.size());
+    }
+
+    void classifier_t::print_profile()
+    {
+        if (!profiler.enabled() || classifier.empty())
+            return;
 
+        auto lease = classifier.acquire();
+        profiler.print(lease.net(), { 1, 3, (int)params.image_size, (int)params.image_size }, path(params.model).filename().string());
+    }
+
+    void classifier_t::attach_timers(cmn::stage_timers_t & timers, const std::string & prefix)
+    {
+        this->timers = &timers;
+        preprocess_stage = timers.add(prefix + "preprocess");
+        forward_stage = timers.add(prefix + "forward");
+    }
+
+    uint64_t classifier_t::model_hash() const
+    {
+        uint64_t model = 0;
+        uint64_t weights = 0;
+        cmn::file_hash(params.model, model);
+        cmn::file_hash(params.weights, weights);
+
+        std::stringstream pre;
+        pre << params.image_size << ' ' << params.scale_factor << ' '
+            << params.mean[0] << ' ' << params.mean[1] << ' ' << params.mean[2] << ' ' << params.mean[3] << ' '
+            << params.swap_RB << ' ' << params.crop << ' ' << params.ddepth;
+        for (const auto & name : outlayers_names)
+            pre << ' ' << name;
+
+        return cmn::hash_combine(cmn::hash_combine(model, weights), cmn::hash64(pre.str()));
+    }
+
+    void classifier_t::process_output(const path & file, const std::vector<cv::Mat> & scores, clf_res_t & result, const clf_array<int> * gt)
+    {
         clf_array<int> gt_idxes;
         gt_idxes.fill(-1);
         clf_array<std::string> gt_names;
         if (params.check_filename)
         {
-            if (!parse_filename(file.filename().string(), gt_idxes, gt_names))
+            if (gt)
+            {
+                gt_idxes = *gt;
+                for (size_t class_id = 0; class_id < params.num_classes; ++class_id)
+                {
+                    if (gt_idxes[class_id] < 0 || (size_t)gt_idxes[class_id] >= params.class_entries[class_id].size())
+                        return;
+                    gt_names[class_id] = params.class_entries[class_id][gt_idxes[class_id]];
+                }
+            }
+            else if (!parse_filename(file.filename().string(), gt_idxes, gt_names))
                 return;
             result.gt = gt_names;
         }
 
+        stat_shard_t & shard = local_shard();
+        result.counted.fill(stat_t::delta_t());
+
         bool correct = true;
         for (size_t class_id = 0; class_id < params.num_classes; ++class_id)
         {
-            pred_vec_t pred(params.class_entries[class_id].size());
-            cv::Mat softmax_out = out[class_id].reshape(1, 1);
+            const cv::Mat & softmax_out = scores[class_id];
 
-            for (size_t j = 0; j < softmax_out.cols; ++j)
-                pred[j] = std::make_pair(j, softmax_out.at<float>(0, (int)j));
+            // only the best <topk> (or <sweep_topk>) predictions are ever read
+            size_t k = std::max<size_t>(stat[class_id].topk, 1u);
+            if (!params.sweep.empty())
+                k = std::max(k, params.sweep_topk);
 
-            std::sort(pred.begin(), pred.end(), pair_desc);
+            // reused by every image processed on this thread
+            thread_local pred_vec_t pred;
+            cmn::topk(softmax_out.ptr<float>(), std::min(params.class_entries[class_id].size(), (size_t)softmax_out.cols), k, pred);
 
-            for (size_t j = 0; j < stat[class_id].topk; ++j)
+            if (!params.sweep.empty())
+                shard.sweep[class_id].add(gt_idxes[class_id], pred);
+
+            for (size_t j = 0; j < std::min(stat[class_id].topk, pred.size()); ++j)
             {
                 int idx = (int)pred[j].first;
                 float rel = pred[j].second;
@@ -260,17 +512,19 @@ namespace clf
                 {
                     if (params.check_filename)
                     {
+                        // class 0 is a valid ground truth, -1 is none
                         int gt_idx = gt_idxes[class_id];
-                        if (gt_idxes[class_id] > 0)
+                        if (gt_idx >= 0)
                         {
-                            correct &= ((size_t)gt_idx == idx);
-                            stat[class_id].add((size_t)gt_idx, pred);
+                            correct &= (gt_idx == idx);
+                            result.counted[class_id] = shard.stat[class_id].add((size_t)gt_idx, pred);
                         }
-                        else
-                            gt_idx = false;
                     }
                     else
-                        stat[class_id].add(idx, pred);
+                        result.counted[class_id] = shard.stat[class_id].add(idx, pred);
+
+                    shard.correct[class_id].store(shard.stat[class_id].conf.getCorrect(), std::memory_order_relaxed);
+                    shard.total[class_id].store(shard.stat[class_id].conf.size(), std::memory_order_relaxed);
                 }
             }
         }
@@ -287,12 +541,15 @@ namespace clf
     {
     }
 
-    void classifier_t::stat_t::add(size_t gt, const pred_vec_t & pred)
+    classifier_t::stat_t::delta_t classifier_t::stat_t::add(size_t gt, const pred_vec_t & pred)
     {
+        delta_t delta;
         size_t num_preds = pred.size();
         if (num_preds && pred[0].second >= thresh)
         {
             conf.add(gt, pred[0].first);
+            delta.gt = (int32_t)gt;
+            delta.pred = (int32_t)pred[0].first;
 
             if (topk > 1 && num_preds >= topk)
             {
@@ -303,8 +560,69 @@ namespace clf
                         wrong = false;
 
                 wrong ? conf_topk.add(gt, pred[0].first) : conf_topk.add(gt, gt);
+                delta.pred_topk = wrong ? delta.pred : delta.gt;
+            }
+        }
+
+        return delta;
+    }
+
+    void classifier_t::stat_t::apply(const delta_t & delta)
+    {
+        if (delta.gt < 0 || (size_t)delta.gt >= num_classes)
+            return;
+
+        if (delta.pred >= 0 && (size_t)delta.pred < num_classes)
+            conf.add((size_t)delta.gt, (size_t)delta.pred);
+        if (delta.pred_topk >= 0 && (size_t)delta.pred_topk < num_classes)
+            conf_topk.add((size_t)delta.gt, (size_t)delta.pred_topk);
+    }
+
+    bool classifier_t::stat_t::save(std::ostream & out) const
+    {
+        for (const confusion_matrix * m : { &conf, &conf_topk })
+        {
+            uint64_t header[2] = { (uint64_t)m->classes(), 0 };
+            std::vector<confusion_matrix::confused_pair_t> cells = m->cells();
+            header[1] = cells.size();
+            out.write((const char *)header, sizeof(header));
+            for (const auto & c : cells)
+            {
+                uint64_t cell[3] = { (uint64_t)c.gt, (uint64_t)c.pred, (uint64_t)c.count };
+                out.write((const char *)cell, sizeof(cell));
             }
         }
+
+        return (bool)out;
+    }
+
+    bool classifier_t::stat_t::load(std::istream & in)
+    {
+        for (confusion_matrix * m : { &conf, &conf_topk })
+        {
+            uint64_t header[2];
+            if (!in.read((char *)header, sizeof(header)) || header[0] != num_classes)
+                return false;
+
+            *m = confusion_matrix(num_classes);
+            for (uint64_t i = 0; i < header[1]; ++i)
+            {
+                uint64_t cell[3];
+                if (!in.read((char *)cell, sizeof(cell)) || cell[0] >= num_classes || cell[1] >= num_classes)
+                    return false;
+                m->add((size_t)cell[0], (size_t)cell[1], (size_t)cell[2]);
+            }
+        }
+
+        return true;
+    }
+
+    classifier_t::stat_t & classifier_t::stat_t::operator += (const stat_t & right)
+    {
+        conf += right.conf;
+        conf_topk += right.conf_topk;
+
+        return *this;
     }
 
     void classifier_t::stat_t::print(const param_t & params, const std::string & name, const std::vector<std::string> & class_entries) const
@@ -365,5 +683,41 @@ namespace clf
                 msg << '(' << std::setprecision(3) << 100. * conf_topk.getCorrect() / conf_topk.size() << "%)\n";
         }
 
+        auto class_name = [&](size_t class_id) { return print_classnames ? class_entries[class_id] : std::to_string(class_id); };
+
+        /* per-class metrics: all classes for small heads, the worst ones otherwise */
+        const size_t MAX_CLASSES_REPORTED = 20;
+        std::vector<size_t> classes;
+        for (size_t class_id = 0; class_id < num_classes; ++class_id)
+            if (conf.getRowSum(class_id) || conf.getColSum(class_id))
+                classes.push_back(class_id);
+        if (!print_conf && classes.size() > MAX_CLASSES_REPORTED)
+        {
+            auto f1_asc = [&](size_t l, size_t r) { return conf.getF1(l) < conf.getF1(r); };
+            std::partial_sort(classes.begin(), classes.begin() + MAX_CLASSES_REPORTED, classes.end(), f1_asc);
+            classes.resize(MAX_CLASSES_REPORTED);
+        }
+
+        if (!classes.empty())
+        {
+            msg << '\n' << (print_conf ? "" : "Worst ") << (name.empty() ? "Precision / recall / F1:\n" : name + " precision / recall / F1:\n");
+            for (size_t class_id : classes)
+                msg << std::setw(15) << class_name(class_id)
+                    << std::setw(8) << std::setprecision(3) << conf.getPrecision(class_id)
+                    << std::setw(8) << std::setprecision(3) << conf.getRecall(class_id)
+                    << std::setw(8) << std::setprecision(3) << conf.getF1(class_id)
+                    << std::setw(8) << conf.getRowSum(class_id) << '\n';
+        }
+
+        auto confused = conf.getTopConfused(MAX_CLASSES_REPORTED);
+        if (!confused.empty())
+        {
+            msg << '\n' << (name.empty() ? "Top confused (gt -> predicted):\n" : name + " top confused (gt -> predicted):\n");
+            for (const auto & pair : confused)
+                msg << std::setw(15) << class_name(pair.gt) << " -> " << std::setw(15) << class_name(pair.pred)
+                    << std::setw(8) << pair.count << '(' << std::setw(3) << conf.getAccuracyPercent(pair.gt, pair.pred) << "%)\n";
+        }
+
+        logger::LOG_MSG(LL::Info, msg.str());
     }
 }
\ No newline at end of file
@@ -1,11 +1,21 @@
 #pragma once
 
 #include "confusion_mat.h"
+#include "threshold_sweep.h"
+#include "../common/label_index.h"
+#include "../common/layer_profiler.h"
+#include "../common/net_pool.h"
+#include "../common/stage_timers.h"
 
 #include <opencv2/dnn.hpp>
 
 #include <array>
+#include <atomic>
+#include <cstdint>
 #include <filesystem>
+#include <iosfwd>
+#include <memory>
+#include <mutex>
 
 namespace clf
 {
@@ -19,8 +29,10 @@ namespace clf
     {
         classifier_t() {}
 
-        cv::dnn::Net classifier;
+        cmn::net_pool_t classifier;
         std::vector<cv::String> outlayers_names;
+        /* enabled by <profile_layers> */
+        cmn::layer_profiler_t profiler;
 
         enum CLASSES
         {
@@ -41,6 +53,7 @@ namespace clf
             std::string weights;
             clf_array<path> filename;
             size_t image_size;
+            size_t replicas;
             bool check_filename;
             CLASSES num_classes;
 
@@ -51,6 +64,11 @@ namespace clf
             bool crop = false;
             int ddepth = 5;
 
+            /* threshold / top-k sweep, disabled if empty */
+            path sweep;
+            float sweep_step = 0.05f;
+            size_t sweep_topk = 5;
+
             parse_filename_func_t filename_parser = nullptr;
             change_filename_func_t filename_changer = nullptr;
         } params;
@@ -68,26 +86,91 @@ namespace clf
             confusion_matrix conf;
             confusion_matrix conf_topk;
 
+            /* cells counted for a single image: row <gt>, columns <pred> of <conf> and <pred_topk> of <conf_topk>, -1 - none */
+            struct delta_t
+            {
+                int32_t gt = -1;
+                int32_t pred = -1;
+                int32_t pred_topk = -1;
+            };
+
             void print(const param_t & params, const std::string & name = std::string(), const std::vector<std::string> & class_entries = std::vector<std::string>()) const;
-            void add(size_t gt, const pred_vec_t & pred);
+            delta_t add(size_t gt, const pred_vec_t & pred);
+            /* replays a delta returned by add(), e.g. from a journal */
+            void apply(const delta_t & delta);
+            /* both matrices as non-zero cells, load() fails on another number of classes */
+            bool save(std::ostream & out) const;
+            bool load(std::istream & in);
+            stat_t & operator += (const stat_t & right);
         };
+        /* label -> class index per head, built by load_class_entries() */
+        clf_array<cmn::label_index_t> class_index;
+
         clf_array<stat_t> stat;
+        clf_array<threshold_sweep_t> sweep;
+
+        /* statistics of a single inference thread, updated without locks and merged by merge_stat() */
+        struct stat_shard_t
+        {
+            clf_array<stat_t> stat;
+            clf_array<threshold_sweep_t> sweep;
+
+            /* top-1 counters published by the owner thread for snapshot() */
+            clf_array<std::atomic<size_t>> correct{};
+            clf_array<std::atomic<size_t>> total{};
+        };
+        std::vector<std::unique_ptr<stat_shard_t>> shards;
+        std::atomic<size_t> shards_generation{ 0 };
+        mutable std::mutex shards_mutex;
 
         struct clf_res_t
         {
             clf_array<std::string> gt;
             clf_array<out_pred_vec_t> rec;
+            /* what process_output() added to the statistics */
+            clf_array<stat_t::delta_t> counted;
 
             bool correct = false;
         };
 
-        bool init_params(const cv::CommandLineParser & cmd);
+        /* <prefix> is prepended to every cmd key, e.g. "clf_" when the classifier is a part of a cascade */
+        bool init_params(const cv::CommandLineParser & cmd, const std::string & prefix = std::string());
         bool load_class_entries(const path & filename, const CLASSES id);
         bool load_classifier();
         bool parse_filename(const std::string & filename_short, clf_array<int> & gt_idx, clf_array<std::string> & gt_names) const;
         std::string change_filename(const std::string & filename_short, const clf_array<out_pred_vec_t> & rec_names) const;
 
+        /* identity of model, weights and preprocessing, for caching raw outputs */
+        uint64_t model_hash() const;
+
+        /* folds all thread shards into <stat> and <sweep>, inference must be finished */
+        void merge_stat();
+        /* running top-1 counters of <stat>, including statistics restored on resume, and all shards, safe to call during inference */
+        void snapshot(clf_array<size_t> & correct, clf_array<size_t> & total) const;
+        /* "<head> correct/total(pct%)" per head from snapshot() */
+        std::string running_accuracy() const;
         void print_stat() const;
+        /* top-1 predictions per class, for runs without ground truth, where <stat> holds no accuracy */
+        void print_predictions() const;
+        /* writes <sweep> and <sweep>_classes.csv */
+        bool save_sweep() const;
         void process_file(const path & file, const cv::Mat & img, clf_res_t & result);
+        /* single forward pass over the batch, results are scattered to the same positions as <imgs> */
+        void process_batch(const std::vector<path> & files, const std::vector<cv::Mat> & imgs, std::vector<clf_res_t> & results);
+        /* single forward pass, <out> holds a [batch, num_classes] matrix per output layer */
+        void forward_batch(const std::vector<cv::Mat> & imgs, std::vector<cv::Mat> & out);
+        /* per-layer times collected by <profile_layers>, FLOPs and memory for a single <image_size> input */
+        void print_profile();
+        /* times preprocessing and forward passes of forward_batch() as <prefix>preprocess / <prefix>forward */
+        void attach_timers(cmn::stage_timers_t & timers, const std::string & prefix = std::string());
+        /* <scores> is a row of raw net output per output layer, <gt> - ground truth parsed beforehand instead of <file>'s name */
+        void process_output(const path & file, const std::vector<cv::Mat> & scores, clf_res_t & result, const clf_array<int> * gt = nullptr);
+
+    private:
+        stat_shard_t & local_shard();
+
+        cmn::stage_timers_t * timers = nullptr;
+        size_t preprocess_stage = 0;
+        size_t forward_stage = 0;
     };
 }
\ No newline at end of file
@@ -1,10 +1,25 @@
 #include "classification_utils.h"
+#include "../common/archive_reader.h"
+#include "../common/dir_cache.h"
+#include "../common/hash.h"
+#include "../common/image_io.h"
+#include "../common/manifest.h"
+#include "../common/progress_reporter.h"
+#include "../common/run_journal.h"
+#include "../common/shard_writer.h"
+#include "../common/stage_timers.h"
 
 #include <filetree_rambler.h>
 #include <file_utils.h>
 
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <sstream>
 #ifdef WITH_OPENCV_HIGHGUI
 #include <opencv2/highgui.hpp>
 #include <iomanip>
@@ -16,6 +31,51 @@ namespace ct
 
     static clf::classifier_t classifier;
     static param_t params;
+    static cmn::pipeline_t<clf_task_t> pipeline;
+    static cmn::result_cache_t cache;
+    static uint64_t model_key = 0;
+    static std::atomic<size_t> cache_hits(0);
+
+    static cmn::dir_cache_t out_dirs;
+    static cmn::shard_writer_t out_shards;
+    static cmn::shard_writer_t mis_shards;
+
+    static const std::vector<std::string> IMAGE_EXT = { ".jpg", ".jpeg", ".png", ".bmp" };
+
+    static cmn::stage_timers_t timers;
+    static cmn::progress_reporter_t reporter;
+
+    /* completed files with the statistics they added, <journaled> is the sum over all records, checkpointed to <journal>.ckpt */
+    static cmn::run_journal_t journal;
+    static std::mutex journal_mutex;
+    static uint64_t journal_config = 0;
+    static clf::classifier_t::clf_array<clf::classifier_t::stat_t> journaled;
+    static cmn::stage_timers_t::timer_clock_t::time_point last_checkpoint;
+    static std::atomic<size_t> skipped(0);
+    /* timer ids in pipeline order, preprocess / forward are registered by the classifier */
+    static struct
+    {
+        size_t scan, enqueue, read, decode, postprocess, annotate, encode, write;
+    } stage;
+    /* end of the previous push, the crawler is single-threaded */
+    static cmn::stage_timers_t::timer_clock_t::time_point scan_mark;
+
+    /* written images are byte-identical to their sources */
+    static bool raw_output()
+    {
+        return params.annotation == 0;
+    }
+
+    /* every image is written to <outdir> or shown, so the full resolution is needed anyway,
+    ** unless it is written as is from its source bytes */
+    static bool full_res_decode()
+    {
+        bool full_res = !params.reduced_decode || (params.outdir_mode >= 0 && !raw_output());
+#       ifdef WITH_OPENCV_HIGHGUI
+            full_res |= params.dbg;
+#       endif // WITH_OPENCV_HIGHGUI
+        return full_res;
+    }
 
     bool init_params(const cv::CommandLineParser & cmd)
     {
@@ -36,6 +96,15 @@ namespace ct
             retval = false;
         }
 
+        params.manifest = (path)cmd.get<std::string>("manifest");
+        params.manifest_refresh = cmd.get<int>("manifest_refresh") == 0 ? false : true;
+        params.manifest_only = cmd.get<int>("manifest_only") == 0 ? false : true;
+        if (params.manifest_only && params.manifest.empty())
+        {
+            logger::LOG_MSG(LL::Error, "<manifest_only>=1 requires <manifest>.");
+            retval = false;
+        }
+
         int outdir_mode = cmd.get<int>("outdir_mode");
         if (outdir_mode < -1 || outdir_mode > 1)
         {
@@ -44,7 +113,7 @@ namespace ct
         }
         params.outdir_mode = outdir_mode;
 
-        if (!cmd.has("outdir") && outdir_mode >= 0)
+        if (!cmd.has("outdir") && outdir_mode >= 0 && !params.manifest_only)
         {
             logger::LOG_MSG(LL::Error, "<outdir> must be specified\n");
             retval = false;
@@ -55,6 +124,34 @@ namespace ct
         if (params.annotation == 2)
             params.thumbnails_dir = (path)cmd.get<std::string>("thumbnails_dir");
         params.move_out= cmd.get<int>("move_out") == 0 ? false : true;
+        params.reduced_decode = cmd.get<int>("reduced_decode") == 0 ? false : true;
+        params.archives = cmd.get<int>("archives") == 0 ? false : true;
+        params.shard_size = cmd.get<size_t>("shard_size");
+        if (params.move_out && params.shard_size)
+        {
+            // shards are written asynchronously, a source removed before its shard is on disk could be lost
+            logger::LOG_MSG(LL::Error, "<move_out>=1 can not be combined with <shard_size>.");
+            retval = false;
+        }
+        params.cache = (path)cmd.get<std::string>("cache");
+        params.progress = cmd.get<size_t>("progress");
+        params.timing_json = (path)cmd.get<std::string>("timing_json");
+        params.progress_interval = cmd.get<size_t>("progress_interval");
+        params.progress_json = (path)cmd.get<std::string>("progress_json");
+        params.journal = (path)cmd.get<std::string>("journal");
+        params.resume = cmd.get<int>("resume") == 0 ? false : true;
+        params.checkpoint_interval = cmd.get<size_t>("checkpoint_interval");
+        if (params.resume && params.journal.empty())
+        {
+            logger::LOG_MSG(LL::Error, "<resume>=1 requires <journal>.");
+            retval = false;
+        }
+        params.pipeline.decode_threads = std::max<size_t>(cmd.get<size_t>("decode_threads"), 1u);
+        params.pipeline.infer_threads = cmd.get<size_t>("infer_threads");
+        params.pipeline.encode_threads = std::max<size_t>(cmd.get<size_t>("encode_threads"), 1u);
+        params.pipeline.queue_size = std::max<size_t>(cmd.get<size_t>("queue_size"), 1u);
+        params.pipeline.batch_size = std::max<size_t>(cmd.get<size_t>("batch_size"), 1u);
+        params.pipeline.batch_wait = std::chrono::milliseconds(cmd.get<size_t>("batch_wait"));
 
 
         params.misdir = (path)cmd.get<std::string>("misclassified_dir");
@@ -73,8 +170,43 @@ namespace ct
                 logger::LOG_MSG(LL::Warning, "Wrong values possible. <outdir_mode>=-1, <recheck_misclassified>=-1, <save_misclassified>=-1, and <debug_win>=-1 the program will run without any output and effect.");
 #       endif // WITH_OPENCV_HIGHGUI
 
+        // class lists are still needed for ground truth stored in the manifest
+        if (retval)
+            retval = classifier.init_params(cmd) && (params.manifest_only || classifier.load_classifier());
+
+        // crawling only, no model is loaded
+        if (params.manifest_only)
+            return retval;
+
         if (retval)
-            retval = classifier.init_params(cmd) && classifier.load_classifier();
+        {
+            stage.scan = timers.add("scan");
+            stage.enqueue = timers.add("enqueue_wait");
+            stage.read = timers.add("read");
+            stage.decode = timers.add("decode");
+            classifier.attach_timers(timers);
+            stage.postprocess = timers.add("postprocess");
+            stage.annotate = timers.add("annotate");
+            stage.encode = timers.add("encode");
+            stage.write = timers.add("write");
+        }
+
+        if (retval && !params.cache.empty())
+        {
+            // reduced decode feeds the net with different pixels, so the decode actually used is a part of the model identity
+            model_key = cmn::hash_combine(classifier.model_hash(), full_res_decode() ? 0u : 1u);
+            if (!cache.open(params.cache.string()))
+            {
+                logger::LOG_MSG(LL::Error, "Failed to open result cache: " + params.cache.string());
+                retval = false;
+            }
+            else
+                logger::LOG_MSG(LL::Info, "Result cache: " + params.cache.string() + ", " + std::to_string(cache.size()) + " records.");
+        }
+
+        // by default one inference thread per network replica
+        if (params.pipeline.infer_threads == 0)
+            params.pipeline.infer_threads = classifier.params.replicas;
 
         if (params.recheck_misclassified && !classifier.params.check_filename)
         {
@@ -85,13 +217,268 @@ namespace ct
         return retval;
     }
 
+    /* ground truth indices stored in the manifest are valid only for the same class lists */
+    static uint64_t manifest_labels_key()
+    {
+        if (!classifier.params.check_filename)
+            return 0;
+
+        std::string entries;
+        for (size_t i = 0; i < classifier.params.num_classes; ++i)
+        {
+            for (const auto & entry : classifier.params.class_entries[i])
+                entries += entry + '\n';
+            entries += '\n';
+        }
+        return cmn::hash64(entries);
+    }
+
+    /* model, class lists and the top-k / threshold of every head, journaled statistics are valid only for the same ones */
+    static uint64_t journal_key()
+    {
+        std::stringstream stat_params;
+        stat_params << classifier.params.num_classes << ' ' << classifier.params.check_filename;
+        for (size_t i = 0; i < classifier.params.num_classes; ++i)
+            stat_params << ' ' << classifier.stat[i].topk << ' ' << classifier.stat[i].thresh;
+
+        return cmn::hash_combine(cmn::hash_combine(classifier.model_hash(), manifest_labels_key()), cmn::hash64(stat_params.str()));
+    }
+
+    static const char CHECKPOINT_MAGIC[8] = { 'C', 'N', 'N', 'T', 'C', 'K', '0', '1' };
+
+    static path checkpoint_file()
+    {
+        return path(params.journal.string() + ".ckpt");
+    }
+
+    /* <journaled> with the number of records it covers, <journal_mutex> must be held */
+    static bool save_checkpoint()
+    {
+        // the checkpoint never covers records that are still buffered
+        journal.flush();
+
+        path tmp(checkpoint_file().string() + ".tmp");
+        {
+            std::ofstream out(tmp.string(), std::ios::binary | std::ios::trunc);
+            uint64_t header[2] = { journal_config, (uint64_t)journal.records() };
+            out.write(CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+            out.write((const char *)header, sizeof(header));
+            for (size_t i = 0; i < classifier.params.num_classes; ++i)
+                journaled[i].save(out);
+            if (!out)
+                return false;
+        }
+
+        // the previous checkpoint stays valid until it is replaced
+        std::error_code ec;
+        std::experimental::filesystem::v1::rename(tmp, checkpoint_file(), ec);
+        return !ec;
+    }
+
+    static bool load_checkpoint(size_t & records)
+    {
+        std::ifstream in(checkpoint_file().string(), std::ios::binary);
+        char magic[sizeof(CHECKPOINT_MAGIC)];
+        uint64_t header[2];
+        if (!in.read(magic, sizeof(magic)) || std::memcmp(magic, CHECKPOINT_MAGIC, sizeof(magic)) != 0 ||
+            !in.read((char *)header, sizeof(header)) || header[0] != journal_config)
+            return false;
+
+        for (size_t i = 0; i < classifier.params.num_classes; ++i)
+            if (!journaled[i].load(in))
+                return false;
+
+        records = (size_t)header[1];
+        return true;
+    }
+
+    static bool open_journal()
+    {
+        const size_t heads = classifier.params.num_classes;
+        journal_config = journal_key();
+        if (!journal.open(params.journal.string(), journal_config, heads * sizeof(clf::classifier_t::stat_t::delta_t), params.resume))
+        {
+            logger::LOG_MSG(LL::Error, "Failed to open journal " + params.journal.string() +
+                (params.resume ? ", it may be written with another model, class lists or <topk> / <classifier_threshold>." : "."));
+            return false;
+        }
+
+        // empty matrices with the top-k / thresholds of <stat>
+        journaled = classifier.stat;
+        last_checkpoint = cmn::stage_timers_t::timer_clock_t::now();
+        if (!journal.resumed())
+        {
+            // a checkpoint of an earlier journal would be taken for this one's
+            std::error_code ec;
+            std::experimental::filesystem::v1::remove(checkpoint_file(), ec);
+            return true;
+        }
+
+        // the checkpoint saves replaying the whole journal
+        size_t records = 0;
+        if (!load_checkpoint(records) || records > journal.resumed())
+        {
+            records = 0;
+            journaled = classifier.stat;
+        }
+        journal.replay(records, [heads](uint64_t /* key */, const unsigned char * payload)
+        {
+            for (size_t i = 0; i < heads; ++i)
+            {
+                clf::classifier_t::stat_t::delta_t delta;
+                std::memcpy(&delta, payload + i * sizeof(delta), sizeof(delta));
+                journaled[i].apply(delta);
+            }
+        });
+
+        for (size_t i = 0; i < heads; ++i)
+            classifier.stat[i] += journaled[i];
+
+        logger::LOG_MSG(LL::Info, "Resuming " + params.journal.string() + ": " + std::to_string(journal.resumed()) + " files are done, statistics of " +
+            std::to_string(records) + " restored from the checkpoint, of " + std::to_string(journal.resumed() - records) + " replayed.");
+        if (!classifier.params.sweep.empty())
+            logger::LOG_MSG(LL::Warning, "<sweep> is not journaled, it covers only the files processed after resuming.");
+        return true;
+    }
+
+    /* completed by the run being resumed */
+    static bool is_done(const path & file)
+    {
+        if (!journal.resumed() || !journal.contains(cmn::hash64(file.string())))
+            return false;
+
+        ++skipped;
+        return true;
+    }
+
+    using counted_t = decltype(clf::classifier_t::clf_res_t::counted);
+
+    /* once the outputs of the file are written, or flushed to their shard */
+    static void journal_file(uint64_t key, const counted_t & counted)
+    {
+        std::lock_guard<std::mutex> lg(journal_mutex);
+        journal.append(key, counted.data());
+        for (size_t i = 0; i < classifier.params.num_classes; ++i)
+            journaled[i].apply(counted[i]);
+
+        auto now = cmn::stage_timers_t::timer_clock_t::now();
+        if (params.checkpoint_interval && now - last_checkpoint >= std::chrono::seconds(params.checkpoint_interval))
+        {
+            if (!save_checkpoint())
+                logger::LOG_MSG(LL::Warning, "Failed to write checkpoint " + checkpoint_file().string());
+            last_checkpoint = now;
+        }
+    }
+
+    /* journals the task from the shard writer thread, a member lost on a write error is never journaled */
+    static cmn::shard_writer_t::written_func_t journal_when_written(clf_task_t & task)
+    {
+        if (!journal.is_open())
+            return cmn::shard_writer_t::written_func_t();
+
+        task.sharded = true;
+        uint64_t key = cmn::hash64(task.file.string());
+        counted_t counted = task.result.counted;
+        return [key, counted]() { journal_file(key, counted); };
+    }
+
+    /* dropped by an exception in decode or inference, not journaled, so it is processed again on resume */
+    static void fail_task(clf_task_t & task)
+    {
+        logger::LOG_MSG(LL::Warning, "Failed to process image: " + task.file.string());
+        reporter.add_failed();
+    }
+
+    static void finish_task(clf_task_t & task)
+    {
+        // failed files are processed again on resume
+        if (encode_file(task) && journal.is_open() && !task.sharded)
+            journal_file(cmn::hash64(task.file.string()), task.result.counted);
+    }
+
+    /* builds <manifest> on the first run, re-lists directories whose mtime changed on <manifest_refresh> */
+    static bool update_manifest(const ftr::settings_t & scan)
+    {
+        namespace fs = std::experimental::filesystem::v1;
+        if (!fs::is_directory(params.indir))
+        {
+            logger::LOG_MSG(LL::Error, "<manifest> requires <indir> to be a directory: " + params.indir.string());
+            return false;
+        }
+
+        cmn::manifest_t::settings_t settings;
+        settings.ext_list = scan.ext_list;
+        settings.check_subdirs = scan.check_subdirs;
+        settings.max_subdir_depth = scan.max_subdir_depth;
+
+        bool exists = fs::exists(params.manifest);
+        if (exists && !cmn::manifest_t::same_scan(params.manifest.string(), settings))
+            logger::LOG_MSG(LL::Info, "Manifest was crawled with other scan settings, it is rebuilt: " + params.manifest.string());
+        else if (exists && !params.manifest_refresh)
+            return true;
+
+        if (classifier.params.check_filename)
+        {
+            // filenames are parsed once here instead of on every run
+            settings.num_labels = classifier.params.num_classes;
+            settings.labels_key = manifest_labels_key();
+            settings.labeler = [](const std::string & filename_short, std::vector<int> & labels)
+            {
+                clf::classifier_t::clf_array<int> gt_idx;
+                gt_idx.fill(-1);
+                clf::classifier_t::clf_array<std::string> gt_names;
+                bool gt_ok = classifier.parse_filename(filename_short, gt_idx, gt_names);
+                std::copy_n(gt_idx.begin(), labels.size(), labels.begin());
+                return gt_ok;
+            };
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        if (!cmn::manifest_t::build(params.indir, settings, params.manifest.string(), exists))
+        {
+            logger::LOG_MSG(LL::Error, "Failed to write manifest: " + params.manifest.string());
+            return false;
+        }
+
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        logger::LOG_MSG(LL::Info, std::string(exists ? "Manifest is refreshed in " : "Manifest is built in ") + std::to_string(sec) + " s: " + params.manifest.string());
+        return true;
+    }
+
     void process_dir()
     {
+        ftr::settings_t settings;
+        settings.check_subdirs = (params.indir_mode != 0);
+        settings.max_subdir_depth = (params.indir_mode == -1 ? 0u : (size_t)params.indir_mode);
+        settings.ext_list = IMAGE_EXT;
+        if (params.archives)
+            settings.ext_list.insert(settings.ext_list.end(), { ".tar", ".zip" });
+        // the crawler only feeds the pipeline, decoding is done by the decode pool
+        settings.max_threads = 1u;
+
+        if (!params.manifest.empty() && !update_manifest(settings))
+            return;
+        if (params.manifest_only)
+            return;
+        if (!params.journal.empty() && !open_journal())
+            return;
+
         if (params.outdir_mode != -1)
             ftr::create_dir(params.outdir);
         if (params.save_misclassified != -1)
             ftr::create_dir(params.misdir);
 
+        if (params.shard_size)
+        {
+            uint64_t shard_size = (uint64_t)params.shard_size << 20;
+            if ((params.outdir_mode != -1 && !out_shards.open(params.outdir.string(), "images", shard_size, params.pipeline.queue_size)) ||
+                (params.save_misclassified != -1 && !mis_shards.open(params.misdir.string(), "misclassified", shard_size, params.pipeline.queue_size)))
+            {
+                logger::LOG_MSG(LL::Error, "Failed to open output shards.");
+                return;
+            }
+        }
+
 #       ifdef WITH_OPENCV_HIGHGUI
             if (params.recheck_misclassified)
                 logger::LOG_MSG(LL::Info,
@@ -103,24 +490,358 @@ namespace ct
                     "any key to save image to <misdir>");
 #       endif // WITH_OPENCV_HIGHGUI
 
-        ftr::settings_t settings;
-        settings.check_subdirs = (params.indir_mode != 0);
-        settings.max_subdir_depth = (params.indir_mode == -1 ? 0u : (size_t)params.indir_mode);
-        settings.ext_list = { ".jpg", ".jpeg", ".png", ".bmp" };
+        cmn::pipeline_settings_t pipeline_settings = params.pipeline;
 #       ifdef WITH_OPENCV_HIGHGUI
             if (params.dbg || params.recheck_misclassified)
-                settings.max_threads = 1u; // TODO: check cv::waitkey() threadsafety
-            else
-                settings.max_threads = 16u;
-#       else
-            settings.max_threads = 16u;
+            {
+                // TODO: check cv::waitkey() threadsafety
+                pipeline_settings.encode_threads = 1u;
+                pipeline_settings.batch_size = 1u;
+            }
 #       endif // WITH_OPENCV_HIGHGUI
 
-        ftr::scan(params.indir, process_file, settings);
+        timers.start();
+        scan_mark = cmn::stage_timers_t::timer_clock_t::now();
+        pipeline.start(pipeline_settings, decode_file, infer_batch, finish_task, fail_task);
+        reporter.add_gauge("decode", []() { return pipeline.decode_queue_size(); });
+        reporter.add_gauge("infer", []() { return pipeline.infer_queue_size(); });
+        reporter.add_gauge("encode", []() { return pipeline.encode_queue_size(); });
+        if (classifier.params.check_filename)
+            reporter.set_extra([]() { return "accuracy " + classifier.running_accuracy(); });
+        reporter.start(std::chrono::seconds(params.progress_interval), params.progress, params.progress_json.string());
+        if (cmn::archive_reader_t::is_archive(params.indir.string()) && !std::experimental::filesystem::v1::is_directory(params.indir))
+            enqueue_archive(params.indir);
+        else if (!params.manifest.empty())
+        {
+            // the manifest may be built with other input options
+            bool complete = cmn::manifest_t::read(params.manifest.string(), params.indir, manifest_labels_key(),
+                [&](const path & file, const cmn::manifest_t::entry_t & entry)
+                {
+                    const auto & ext_list = settings.ext_list;
+                    if (std::find(ext_list.begin(), ext_list.end(), cmn::lower_ext(file.string())) != ext_list.end())
+                        enqueue_entry(file, entry);
+                });
+            if (!complete)
+                logger::LOG_MSG(LL::Warning, "Manifest is damaged, only its readable part is processed: " + params.manifest.string());
+        }
+        else
+            ftr::scan(params.indir, enqueue_file, settings);
+        reporter.scan_finished();
+        pipeline.finish();
+        reporter.stop();
+
+        // sharded files are journaled by the shard writers, so they are drained first
+        for (auto shards : { &out_shards, &mis_shards })
+            if (shards->is_open())
+            {
+                shards->close();
+                logger::LOG_MSG(LL::Info, "Images written: " + std::to_string(shards->members()) + " in " + std::to_string(shards->shards()) + " shards.");
+            }
+
+        if (journal.is_open())
+        {
+            std::lock_guard<std::mutex> lg(journal_mutex);
+            if (!save_checkpoint())
+                logger::LOG_MSG(LL::Warning, "Failed to write checkpoint " + checkpoint_file().string());
+            logger::LOG_MSG(LL::Info, "Journal: " + std::to_string(journal.records()) + " files done, " + std::to_string(skipped.load()) + " skipped as done before resuming.");
+            journal.close();
+        }
+
+        if (cache.is_open())
+            logger::LOG_MSG(LL::Info, "Result cache hits: " + std::to_string(cache_hits.load()));
+
+        timers.stop();
+
+        classifier.merge_stat();
         classifier.print_stat();
+        classifier.save_sweep();
+        classifier.print_profile();
+
+        timers.print();
+        if (!params.timing_json.empty())
+        {
+            if (timers.save_json(params.timing_json.string()))
+                logger::LOG_MSG(LL::Info, "Stage timings are saved to " + params.timing_json.string());
+            else
+                logger::LOG_MSG(LL::Error, "Failed to write " + params.timing_json.string());
+        }
+    }
+
+    /* crawler time since the previous push, then the time blocked on a full decode queue */
+    static void push_task(std::unique_ptr<clf_task_t> task)
+    {
+        auto now = cmn::stage_timers_t::timer_clock_t::now();
+        timers.record(stage.scan, now - scan_mark);
+        reporter.add_enqueued();
+        pipeline.push(std::move(task));
+        scan_mark = cmn::stage_timers_t::timer_clock_t::now();
+        timers.record(stage.enqueue, scan_mark - now);
+    }
+
+    void enqueue_file(const path & file, std::mutex & /* scan_mutex */)
+    {
+        if (params.archives && cmn::archive_reader_t::is_archive(file.string()))
+        {
+            enqueue_archive(file);
+            return;
+        }
+        if (is_done(file))
+            return;
+
+        std::unique_ptr<clf_task_t> task(new clf_task_t);
+        task->file = file;
+        push_task(std::move(task));
+    }
+
+    void enqueue_entry(const path & file, const cmn::manifest_t::entry_t & entry)
+    {
+        if (params.archives && cmn::archive_reader_t::is_archive(file.string()))
+        {
+            enqueue_archive(file);
+            return;
+        }
+        if (is_done(file))
+            return;
+
+        std::unique_ptr<clf_task_t> task(new clf_task_t);
+        task->file = file;
+        if (entry.labels_ok && entry.labels.size() == classifier.params.num_classes)
+        {
+            task->has_gt = true;
+            task->gt_idx.fill(-1);
+            std::copy(entry.labels.begin(), entry.labels.end(), task->gt_idx.begin());
+        }
+        push_task(std::move(task));
+    }
+
+    void enqueue_archive(const path & archive)
+    {
+        cmn::archive_reader_t reader;
+        if (!reader.open(archive.string(), params.pipeline.queue_size))
+        {
+            logger::LOG_MSG(LL::Warning, "Failed to open archive: " + archive.string());
+            return;
+        }
+
+        cmn::archive_reader_t::member_t member;
+        while (reader.next(member))
+        {
+            path file = archive / member.name;
+            std::string ext = cmn::lower_ext(file.string());
+            if (std::find(IMAGE_EXT.begin(), IMAGE_EXT.end(), ext) == IMAGE_EXT.end() || is_done(file))
+                continue;
+
+            // ground truth is parsed from the member's own filename
+            std::unique_ptr<clf_task_t> task(new clf_task_t);
+            task->file = file;
+            task->bytes.swap(member.data);
+            task->archived = true;
+            push_task(std::move(task));
+        }
+    }
+
+    bool decode_file(clf_task_t & task)
+    {
+        bool full_res = full_res_decode();
+        bool need_img = params.outdir_mode >= 0 && !raw_output();
+#       ifdef WITH_OPENCV_HIGHGUI
+            need_img |= params.dbg;
+#       endif // WITH_OPENCV_HIGHGUI
+
+        size_t image_size = classifier.params.image_size;
+        cv::Size min_size((int)image_size, (int)image_size);
+
+        // archive members are already in memory
+        if (!task.archived)
+        {
+            cmn::stage_timers_t::scope_t t(timers, stage.read);
+            if (!cmn::read_file(task.file.string(), task.bytes))
+            {
+                logger::LOG_MSG(LL::Warning, "Failed to read image: " + task.file.string());
+                reporter.add_failed();
+                return false;
+            }
+        }
+        timers.add_read(task.bytes.size());
+
+        if (cache.is_open())
+        {
+            task.cache_key = cmn::result_cache_t::make_key(cmn::hash64(task.bytes.data(), task.bytes.size()), model_key);
+            task.cache_hit = cache.find(task.cache_key, task.cached) && task.cached.size() == classifier.outlayers_names.size();
+
+            // no forward pass, the image is decoded later only if it is written or shown
+            if (task.cache_hit && !need_img)
+                return true;
+        }
+
+        {
+            cmn::stage_timers_t::scope_t t(timers, stage.decode);
+            task.img = full_res ?
+                cv::imdecode(task.bytes, cv::IMREAD_COLOR) :
+                cmn::imdecode_reduced(task.bytes, min_size, task.decode_factor);
+        }
+        // unannotated images are written from their bytes, the source is not read again
+        if (task.decode_factor == 1 && !raw_output())
+            std::vector<uchar>().swap(task.bytes);
+
+        if (task.img.empty())
+        {
+            logger::LOG_MSG(LL::Warning, "Failed to load image: " + task.file.string());
+            reporter.add_failed();
+            return false;
+        }
+
+        return true;
+    }
+
+    static void report_progress(size_t batch_size)
+    {
+        timers.add_images(batch_size);
+        reporter.add_done(batch_size);
+    }
+
+    void infer_batch(std::vector<clf_task_t *> & batch)
+    {
+        std::vector<clf_task_t *> misses;
+        std::vector<cv::Mat> scores(classifier.outlayers_names.size());
+        for (const auto task : batch)
+        {
+            if (!task->cache_hit)
+            {
+                misses.push_back(task);
+                continue;
+            }
+
+            for (size_t i = 0; i < task->cached.size(); ++i)
+                scores[i] = cv::Mat(1, (int)task->cached[i].size, CV_32F, (void *)task->cached[i].data);
+            {
+                cmn::stage_timers_t::scope_t t(timers, stage.postprocess);
+                classifier.process_output(task->file, scores, task->result, task->has_gt ? &task->gt_idx : nullptr);
+            }
+            ++cache_hits;
+        }
+
+        if (misses.empty())
+        {
+            report_progress(batch.size());
+            return;
+        }
+
+        std::vector<cv::Mat> imgs;
+        for (const auto task : misses)
+            imgs.push_back(task->img);
+
+        std::vector<cv::Mat> out;
+        classifier.forward_batch(imgs, out);
+
+        std::vector<cmn::result_cache_t::part_t> parts(out.size());
+        for (size_t i = 0; i < misses.size(); ++i)
+        {
+            for (size_t j = 0; j < out.size(); ++j)
+            {
+                scores[j] = out[j].row((int)i);
+                parts[j] = { scores[j].ptr<float>(), (size_t)scores[j].cols };
+            }
+
+            if (cache.is_open())
+                cache.append(misses[i]->cache_key, parts);
+            cmn::stage_timers_t::scope_t t(timers, stage.postprocess);
+            classifier.process_output(misses[i]->file, scores, misses[i]->result, misses[i]->has_gt ? &misses[i]->gt_idx : nullptr);
+        }
+
+        report_progress(batch.size());
+    }
+
+    static void load_full_image(clf_task_t & task)
+    {
+        if (task.decode_factor == 1 && !task.img.empty())
+            return;
+
+        cv::Mat full = task.bytes.empty() ?
+            cv::imread(task.file.string(), cv::IMREAD_COLOR) :
+            cv::imdecode(task.bytes, cv::IMREAD_COLOR);
+        if (full.empty())
+        {
+            logger::LOG_MSG(LL::Warning, "Failed to load image: " + task.file.string());
+            return;
+        }
+
+        task.img = full;
+        task.decode_factor = 1;
+    }
+
+    /* output without decode / re-encode: rename within a filesystem when moving,
+    ** otherwise the encoded bytes already in memory or a byte copy of the source */
+    static bool write_raw(clf_task_t & task, const path & dst, const path & member, cmn::shard_writer_t & shards, bool & moved)
+    {
+        namespace fs = std::experimental::filesystem::v1;
+        std::error_code ec;
+
+        if (shards.is_open())
+        {
+            std::vector<uchar> buf;
+            buf.swap(task.bytes);
+            if (buf.empty() && (task.archived || !cmn::read_file(task.file.string(), buf)))
+                return false;
+            timers.add_written(buf.size());
+            return shards.write(member.generic_string(), std::move(buf), journal_when_written(task));
+        }
+
+        if (params.move_out && !task.archived)
+        {
+            fs::rename(task.file, dst, ec);
+            // another filesystem, copied and removed instead
+            moved = !ec;
+            if (moved)
+                return true;
+        }
+
+        if (!task.bytes.empty())
+        {
+            timers.add_written(task.bytes.size());
+            return cmn::write_file(dst.string(), task.bytes);
+        }
+
+        if (task.archived)
+            return false;
+
+        fs::copy_file(task.file, dst, fs::copy_options::overwrite_existing, ec);
+        if (ec)
+            return false;
+
+        std::error_code size_ec;
+        uint64_t size = fs::file_size(dst, size_ec);
+        if (!size_ec)
+            timers.add_written(size);
+        return true;
+    }
+
+    /* encoded on this encode thread, the shard writer only appends */
+    static bool write_image(clf_task_t & task, const cv::Mat & img, const path & dst, const path & member, cmn::shard_writer_t & shards)
+    {
+        std::vector<uchar> buf;
+        {
+            cmn::stage_timers_t::scope_t t(timers, stage.encode);
+            if (!cv::imencode(dst.extension().string(), img, buf))
+            {
+                logger::LOG_MSG(LL::Warning, "Failed to encode image: " + dst.string());
+                return false;
+            }
+        }
+
+        cmn::stage_timers_t::scope_t t(timers, stage.write);
+        timers.add_written(buf.size());
+        if (shards.is_open())
+            return shards.write(member.generic_string(), std::move(buf), journal_when_written(task));
+        if (!cmn::write_file(dst.string(), buf))
+        {
+            logger::LOG_MSG(LL::Warning, "Failed to write image: " + dst.string());
+            return false;
+        }
+        return true;
     }
 
-    void process_file(const path & file, std::mutex & dnn_mutex)
+    bool encode_file(clf_task_t & task)
     {
         try
         {
@@ -129,25 +850,26 @@ namespace ct
             const std::string win_label("classification");
             const std::string recheck_win_lbl("RECHECK classification");
 
+            const path & file = task.file;
+            const cv::Mat & img = task.img;
+            const clf::classifier_t::clf_res_t & result = task.result;
+
             bool new_outname = params.outname_from_classification;
             bool mis = false;
-
-            cv::Mat img = cv::imread(file.string(), cv::IMREAD_COLOR);
             cv::Mat dbg_img;
-            if (img.empty())
-            {
-                logger::LOG_MSG(LL::Warning, "Failed to load image: " + file.string());
-                return;
-            }
 
-            clf::classifier_t::clf_res_t result;
-            {
-                std::lock_guard<std::mutex> lg(dnn_mutex);
-                classifier.process_file(file, img, result);
-            }
+            // reduced decode is upgraded only for images that are shown or written with annotation
+            bool need_full = raw_output() ? false : params.outdir_mode >= 0 || (params.save_misclassified >= 0 && !result.correct);
+#           ifdef WITH_OPENCV_HIGHGUI
+                need_full |= params.dbg || (params.recheck_misclassified && !result.correct);
+#           endif // WITH_OPENCV_HIGHGUI
+            if (need_full)
+                load_full_image(task);
 
-            if (params.recheck_misclassified || params.dbg || params.annotation)
+            // cache hits are decoded only when needed
+            if ((params.recheck_misclassified || params.dbg || params.annotation) && !img.empty())
             {
+                cmn::stage_timers_t::scope_t t(timers, stage.annotate);
                 if (params.annotation <= 1)
                     label_img(img, dbg_img, result);
                 else
@@ -184,7 +906,7 @@ namespace ct
 
             /* disable output */
             if (params.outdir_mode < 0 && params.save_misclassified < 0)
-                return;
+                return true;
 
             path dst;
             if (mis)
@@ -192,23 +914,50 @@ namespace ct
             else if (params.outdir_mode >= 0)
                 dst = params.outdir;
             else
-                return;
+                return true;
+
+            // shards keep the same member names, relative to their root
+            cmn::shard_writer_t & shards = mis ? mis_shards : out_shards;
+            path member;
 
             if (params.outdir_mode == 1)
             {
-                dst.append(ftr::subdirs(file.parent_path(), params.indir));
-                ftr::create_dir(dst);
+                member = ftr::subdirs(file.parent_path(), params.indir);
+                dst.append(member);
+                if (!shards.is_open())
+                    out_dirs.create(dst);
+            }
+            path filename = new_outname ?
+                path(classifier.change_filename(file.filename().string(), result.rec)) :
+                file.filename();
+            dst.append(filename);
+            member.append(filename);
+
+            // the source file itself is the output unless it is annotated or converted to another format
+            bool raw = raw_output() && cmn::lower_ext(file.string()) == cmn::lower_ext(dst.string());
+            bool moved = false;
+            bool written = false;
+            if (raw)
+            {
+                cmn::stage_timers_t::scope_t t(timers, stage.write);
+                written = write_raw(task, dst, member, shards, moved);
+            }
+            if (written)
+            {
+                if (params.move_out && !moved && !task.archived)
+                    ftr::remove_file(file);
+                return true;
             }
-            dst.append(new_outname ?
-                classifier.change_filename(file.filename().string(), result.rec) :
-                file.filename());
 
-            params.annotation ?
-                cv::imwrite(dst.string(), dbg_img) :
-                cv::imwrite(dst.string(), img);
+            load_full_image(task);
+            const cv::Mat & out_img = params.annotation ? dbg_img : img;
+            if (!write_image(task, out_img, dst, member, shards))
+                return false;
 
-            if (params.move_out)
+            // archives are left intact, a source is removed only once its output is written
+            if (params.move_out && !task.archived)
                 ftr::remove_file(file);
+            return true;
         }
         catch (cv::Exception & e)
         {
@@ -222,6 +971,7 @@ namespace ct
         {
             logger::LOG_MSG(LL::Error, "Unknown exception.");
         }
+        return false;
     }
 
     void label_img(const cv::Mat & img, cv::Mat & labeled, const clf::classifier_t::clf_res_t & result)
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "classification.h"
+#include "../common/manifest.h"
+#include "../common/pipeline.h"
+#include "../common/result_cache.h"
 
 #include <filesystem>
 
@@ -14,26 +17,81 @@ namespace ct
     struct param_t
     {
         path indir;
+        /* binary listing of <indir> read instead of crawling it, built if missing,
+        ** updated with <manifest_refresh>, <manifest_only> stops right after that */
+        path manifest;
+        bool manifest_refresh;
+        bool manifest_only;
         path outdir;
         path misdir;
         path thumbnails_dir;
+        path cache;
         int save_misclassified;
         int indir_mode;
         int outdir_mode;
         bool outname_from_classification;
         int annotation;
         bool move_out;
+        bool reduced_decode;
+        /* .tar / .zip files in <indir> are read as image folders, <indir> may be an archive itself */
+        bool archives;
+        /* images are appended to rolling .tar shards of this size (MB) in <outdir> / <misdir>, 0 - separate files */
+        size_t shard_size;
+        /* progress line every <progress> images besides the timed ones, 0 - disabled */
+        size_t progress;
+        /* per-stage latency histograms and throughput as .json, disabled if empty */
+        path timing_json;
+        /* progress reporter, disabled if <progress_interval> is 0 */
+        size_t progress_interval;
+        path progress_json;
+        /* completed files are journaled, <resume> skips them and restores their statistics
+        ** from <journal>.ckpt written every <checkpoint_interval> s and the journal records after it */
+        path journal;
+        bool resume;
+        size_t checkpoint_interval;
+        cmn::pipeline_settings_t pipeline;
 #       ifdef WITH_OPENCV_HIGHGUI
         bool dbg;
         bool recheck_misclassified;
 #       endif //WITH_OPENCV_HIGHGUI
     };
 
+    struct clf_task_t
+    {
+        path file;
+        cv::Mat img;
+        int decode_factor = 1;
+        clf::classifier_t::clf_res_t result;
+
+        /* encoded file, kept only while a full resolution decode may still be needed */
+        std::vector<uchar> bytes;
+        uint64_t cache_key = 0;
+        bool cache_hit = false;
+        std::vector<cmn::result_cache_t::part_t> cached;
+        /* archive member, <file> is <archive>/<member name> and <bytes> are read by the archive reader */
+        bool archived = false;
+        /* ground truth read from the manifest, the filename is not parsed again */
+        bool has_gt = false;
+        clf::classifier_t::clf_array<int> gt_idx;
+        /* output handed to the shard writer, journaled by it once persisted */
+        bool sharded = false;
+    };
+
     bool init_params(const cv::CommandLineParser & cmd);
     void process_dir();
 
-    /* thread func */
-    void process_file(const path & file, std::mutex & dnn_mutex);
+    /* ftr::scan callback, feeds the pipeline */
+    void enqueue_file(const path & file, std::mutex & scan_mutex);
+    /* manifest entry, feeds the pipeline with ground truth parsed at build time */
+    void enqueue_entry(const path & file, const cmn::manifest_t::entry_t & entry);
+    /* streams images out of a .tar / .zip archive, a task per member */
+    void enqueue_archive(const path & archive);
+
+    /* pipeline stages */
+    bool decode_file(clf_task_t & task);
+    void infer_batch(std::vector<clf_task_t *> & batch);
+    /* false if an output of the task failed to be written */
+    bool encode_file(clf_task_t & task);
     void label_img(const cv::Mat & img, cv::Mat & labeled, const clf::classifier_t::clf_res_t & result);
     void label_img_with_thumbnails(const cv::Mat & img, cv::Mat & labeled, const clf::classifier_t::clf_res_t & result);
 }
\ No newline at end of file
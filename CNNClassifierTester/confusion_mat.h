@@ -1,66 +1,107 @@
 #pragma once
 
+#include <algorithm>
 #include <cassert>
+#include <cstdint>
+#include <unordered_map>
 #include <vector>
 
 namespace clf
 {
-    class vector_counter : public std::vector<size_t>
+    class confusion_matrix
     {
     public:
-        vector_counter() {};
-
-        vector_counter(const size_t size, const size_t value = 0)
-            : std::vector<size_t>(size, value)
-            , _Size(size) {}
-
-        virtual ~vector_counter() = default;
+        /* classes up to this size are stored as a flat dense matrix (8 MB),
+        ** larger ones keep only non-zero off-diagonal cells in a hash map */
+        static const size_t DENSE_MAX_SIZE = 1024;
 
-        vector_counter & operator += (const vector_counter & right)
+        struct confused_pair_t
         {
-            assert(_Size == right._Size);
-
-            for (size_t i = 0; i < _Size; ++i)
-                this->data()[i] += right.data()[i];
-
-            return *this;
-        }
-
-    private:
-        size_t _Size;
-    };
+            size_t gt;
+            size_t pred;
+            size_t count;
+        };
 
-    class confusion_matrix
-    {
-    public:
         confusion_matrix() {};
 
         confusion_matrix(const size_t size, const size_t value = 0)
-            : mat(size + 1, vector_counter(size + 1, value))
-            , _Size(size) {};
+            : _Size(size)
+            , sparse(size > DENSE_MAX_SIZE && value == 0)
+            , diag(size, value)
+            , row_sum(size, value * size)
+            , col_sum(size, value * size)
+            , total(value * size * size)
+            , correct(value * size)
+        {
+            if (!sparse)
+                dense.assign(size * size, value);
+        };
         ~confusion_matrix() = default;
 
         inline void add(size_t x, size_t y)
         {
-            ++mat[x][y];
-            ++mat[x][_Size];
-            ++mat[_Size][y];
-            ++mat[_Size][_Size];
+            if (x == y)
+            {
+                ++diag[x];
+                ++correct;
+            }
+
+            if (!sparse)
+                ++dense[x * _Size + y];
+            else if (x != y)
+                ++off_diag[key(x, y)];
+
+            ++row_sum[x];
+            ++col_sum[y];
+            ++total;
+        }
+
+        /* the same cell <count> times, e.g. when a matrix is restored from cells() */
+        inline void add(size_t x, size_t y, size_t count)
+        {
+            if (!count)
+                return;
+
+            if (x == y)
+            {
+                diag[x] += count;
+                correct += count;
+            }
+
+            if (!sparse)
+                dense[x * _Size + y] += count;
+            else if (x != y)
+                off_diag[key(x, y)] += count;
+
+            row_sum[x] += count;
+            col_sum[y] += count;
+            total += count;
         }
 
         inline size_t operator() (size_t x, size_t y) const
         {
-            return mat[x][y];
+            return get(x, y);
         }
 
+        /* x or y equal to the number of classes gives row / column sums, as in the dense layout */
         inline size_t get(size_t x, size_t y) const
         {
-            return mat[x][y];
+            if (x == _Size)
+                return y == _Size ? total : col_sum[y];
+            if (y == _Size)
+                return row_sum[x];
+            if (x == y)
+                return diag[x];
+            if (!sparse)
+                return dense[x * _Size + y];
+
+            auto it = off_diag.find(key(x, y));
+            return it == off_diag.end() ? 0 : it->second;
         }
 
         inline double getAccuracy(size_t x, size_t y) const
         {
-            return mat[x][_Size] ? 1. * mat[x][y] / mat[x][_Size] : 0.;
+            return row_sum[x] ? 1. * get(x, y) / row_sum[x] : 0.;
         }
 
         inline size_t getAccuracyPercent(size_t x, size_t y) const
@@ -70,45 +111,139 @@ namespace clf
 
         inline size_t getColSum (size_t y) const
         {
-            return mat[_Size][y];
+            return col_sum[y];
         }
 
         inline size_t getCorrect() const
         {
-            size_t correct = 0;
-            for (size_t i = 0; i < _Size; ++i)
-                correct += mat[i][i];
-
             return correct;
         }
 
         inline size_t getRowSum(size_t x) const
         {
-            return mat[x][_Size];
+            return row_sum[x];
         }
 
         inline size_t size() const
         {
-            return mat[_Size][_Size];
+            return total;
+        }
+
+        inline size_t classes() const
+        {
+            return _Size;
+        }
+
+        /* TP / (TP + FP) */
+        inline double getPrecision(size_t c) const
+        {
+            return col_sum[c] ? 1. * diag[c] / col_sum[c] : 0.;
+        }
+
+        /* TP / (TP + FN) */
+        inline double getRecall(size_t c) const
+        {
+            return row_sum[c] ? 1. * diag[c] / row_sum[c] : 0.;
+        }
+
+        inline double getF1(size_t c) const
+        {
+            return (row_sum[c] + col_sum[c]) ? 2. * diag[c] / (row_sum[c] + col_sum[c]) : 0.;
+        }
+
+        /* <n> most frequent off-diagonal cells, descending */
+        std::vector<confused_pair_t> getTopConfused(size_t n) const
+        {
+            std::vector<confused_pair_t> pairs;
+            if (!sparse)
+            {
+                for (size_t x = 0; x < _Size; ++x)
+                    for (size_t y = 0; y < _Size; ++y)
+                        if (x != y && dense[x * _Size + y])
+                            pairs.push_back({ x, y, dense[x * _Size + y] });
+            }
+            else
+            {
+                for (const auto & cell : off_diag)
+                    pairs.push_back({ (size_t)(cell.first / _Size), (size_t)(cell.first % _Size), cell.second });
+            }
+
+            auto count_desc = [](const confused_pair_t & l, const confused_pair_t & r) { return l.count > r.count; };
+            n = std::min(n, pairs.size());
+            std::partial_sort(pairs.begin(), pairs.begin() + n, pairs.end(), count_desc);
+            pairs.resize(n);
+
+            return pairs;
+        }
+
+        /* non-zero cells including the diagonal, in no particular order */
+        std::vector<confused_pair_t> cells() const
+        {
+            std::vector<confused_pair_t> res;
+            for (size_t x = 0; x < _Size; ++x)
+                if (diag[x])
+                    res.push_back({ x, x, diag[x] });
+
+            if (!sparse)
+            {
+                for (size_t x = 0; x < _Size; ++x)
+                    for (size_t y = 0; y < _Size; ++y)
+                        if (x != y && dense[x * _Size + y])
+                            res.push_back({ x, y, dense[x * _Size + y] });
+            }
+            else
+            {
+                for (const auto & cell : off_diag)
+                    res.push_back({ (size_t)(cell.first / _Size), (size_t)(cell.first % _Size), cell.second });
+            }
+
+            return res;
         }
 
         confusion_matrix & operator += (const confusion_matrix & right)
         {
-            assert(_Size == right._Size);
+            assert(_Size == right._Size && sparse == right.sparse);
+
+            if (!sparse)
+            {
+                for (size_t i = 0; i < dense.size(); ++i)
+                    dense[i] += right.dense[i];
+            }
+            else
+            {
+                for (const auto & cell : right.off_diag)
+                    off_diag[cell.first] += cell.second;
+            }
 
-            for (size_t i = 0; i <= _Size; ++i)
-                for (size_t j = 0; j <= _Size; ++j)
-                    mat[i][j] += right.mat[i][j];
+            for (size_t i = 0; i < _Size; ++i)
+            {
+                diag[i] += right.diag[i];
+                row_sum[i] += right.row_sum[i];
+                col_sum[i] += right.col_sum[i];
+            }
+            total += right.total;
+            correct += right.correct;
 
             return *this;
         }
 
     private:
-        // square confusion matrix _Size X _Size
-        // mat[i][_Size] = SUM(mat[i][j]) any j from 0 to _Size - 1
-        // mat[_Size][j] = SUM(mat[i][j]) any i from 0 to _Size - 1
-        // mat[_Size][_Size] = SUM(mat[i][j]) any i, j from 0 to _Size - 1
-        std::vector<vector_counter> mat;
-        size_t _Size;
+        inline uint64_t key(size_t x, size_t y) const
+        {
+            return (uint64_t)x * _Size + y;
+        }
+
+        // square confusion matrix _Size X _Size, rows - gt, columns - predictions
+        // sums and the diagonal are kept separately, so they are O(1) in both layouts
+        size_t _Size = 0;
+        bool sparse = false;
+        std::vector<size_t> dense;
+        std::unordered_map<uint64_t, size_t> off_diag;
+
+        std::vector<size_t> diag;
+        std::vector<size_t> row_sum;
+        std::vector<size_t> col_sum;
+        size_t total = 0;
+        size_t correct = 0;
     };
 }
\ No newline at end of file
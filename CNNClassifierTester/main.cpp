@@ -12,20 +12,46 @@ int main(int argc, char ** argv)
         "{filename_as_labels|0|filename in format \"<class_1>[_<class_2>]_*.ext\" if true gt labels from filename compared to classification results}"
         "{image_size |72|classifier's input image size, 3 channels rgb image assumed}"
         "{classifier_mode c|1|1 - single-class classification, 2 - two-classes classification}"
+        "{replicas|4|number of independent network replicas used for parallel inference}"
         "{classifier_threshold_0|0.3|first classifier threshold}"
         "{classes_0|first.txt|path to .txt file with listed classes for first classifier (must be equal to net's output node's name)}"
         "{topk_0 |1|topk predictions in statistics for first classifier (alongside with topk = 1)}"
         "{classifier_threshold_1|0.3|second classifier threshold}"
         "{classes_1|second.txt|path to .txt file with listed classes for second classifier (must be equal to net's output node's name)}"
         "{topk_1 |1|topk predictions in statistics for second classifier (alongside with topk = 1)}"
+        "{profile_layers|0|report per-layer forward times (mean / percentiles / share), FLOPs and memory of the network}"
+        "{profile_warmup|16|number of network inputs per replica passed before <profile_layers> starts collecting}"
+        "{sweep||path to output .csv with accuracy / coverage over a grid of thresholds and k, per-class precision / recall go to <sweep>_classes.csv (empty - disabled)}"
+        "{sweep_step|0.05|threshold step for <sweep>, thresholds from 0 to 1}"
+        "{sweep_topk|5|max k for <sweep>, k from 1 to <sweep_topk>}"
 
         /* classifier tester params */
         "{indir||path to dir with test images}"
         "{indir_mode|0|0 - root folder only, 1 - allowed subdirs depth (-1 for any depth)}"
+        "{manifest||path to binary listing of <indir> with ground truth parsed from filenames, built on the first run and read instead of crawling <indir> (empty - disabled)}"
+        "{manifest_refresh|0|update <manifest> first, only directories whose mtime changed are listed again}"
+        "{manifest_only|0|only build / refresh <manifest>, no model is loaded}"
         "{outdir||path to output dir for classification results}"
         "{outdir_mode|0|-1 - disable output, 0 - common root folder, 1 - separate folders}"
         "{out_filename|0|0 - with filename from classified labels, 1 - with original filename}"
         "{move_out|0|move images to output directory (copy by default)}"
+        "{cache||path to inference result cache file, reused across runs with the same images, model and preprocessing (empty - disabled)}"
+        "{shard_size|0|append output images to rolling .tar shards of this size (MB) with a .index.csv instead of separate files (0 - disabled, not with move_out)}"
+        "{archives|0|read images from .tar and .zip (stored) files in <indir> without extraction, <indir> may be an archive itself}"
+        "{reduced_decode|0|decode JPEGs at 1/2, 1/4 or 1/8 scale still covering <image_size>, full resolution only for written / shown images}"
+        "{decode_threads|8|number of image decoding threads}"
+        "{infer_threads|0|number of inference threads (0 - one per network replica)}"
+        "{encode_threads|4|number of annotation / writing threads}"
+        "{queue_size|64|max number of images queued between pipeline stages}"
+        "{batch_size|8|max number of images in a single forward pass}"
+        "{batch_wait|10|max time (ms) to wait for a batch to fill before running forward}"
+        "{progress|10000|also log a progress line with running accuracy every n images (0 - disabled)}"
+        "{timing_json||path to output .json with per-stage latency histograms, images/sec and bytes read / written (empty - disabled)}"
+        "{progress_interval|30|seconds between lines with images done / failed, images/sec, queue depths and ETA (0 - disabled)}"
+        "{progress_json||path to a .json rewritten with every progress line (empty - disabled)}"
+        "{journal||path to an append-only journal of completed files and the statistics they added (empty - disabled)}"
+        "{resume|0|skip files completed in <journal> and restore their statistics, otherwise the journal is started over}"
+        "{checkpoint_interval|300|seconds between checkpoints of the journaled statistics to <journal>.ckpt (0 - only at the end)}"
         "{annotation|0|classification annotation of output images, 1 - text annotation, 2 - thumbnail annotation (single-class classification only)}"
         "{thumbnails_dir||path to thumbnails for annotation (if annotation=2), filenames in format <class_1>.jpg}"
         "{save_misclassified mis|0|save misclassified images (only if filename_as_labels = 1): 0 - with filename from classified labels, 1 - with original filename, -1 - don't save misclasified}"
@@ -0,0 +1,134 @@
+#include "threshold_sweep.h"
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+
+namespace clf
+{
+    threshold_sweep_t::threshold_sweep_t(size_t num_classes, size_t topk)
+        : num_classes(num_classes)
+        , k(std::max<size_t>(std::min(topk, num_classes), 1u))
+    {
+    }
+
+    void threshold_sweep_t::add(int gt_idx, const std::vector<std::pair<size_t, float>> & pred)
+    {
+        gt.push_back(gt_idx);
+        for (size_t i = 0; i < k; ++i)
+        {
+            bool valid = i < pred.size();
+            idx.push_back(valid ? (uint32_t)pred[i].first : 0u);
+            score.push_back(valid ? pred[i].second : -1.f);
+        }
+    }
+
+    threshold_sweep_t & threshold_sweep_t::operator += (const threshold_sweep_t & right)
+    {
+        gt.insert(gt.end(), right.gt.begin(), right.gt.end());
+        idx.insert(idx.end(), right.idx.begin(), right.idx.end());
+        score.insert(score.end(), right.score.begin(), right.score.end());
+
+        return *this;
+    }
+
+    void threshold_sweep_t::write_csv_header(std::ostream & summary, std::ostream & per_class)
+    {
+        summary << "head,thresh,k,images,accepted,coverage,labeled,correct,accuracy\n";
+        per_class << "head,thresh,class,gt,predicted,tp,precision,recall\n";
+    }
+
+    void threshold_sweep_t::write_csv(std::ostream & summary, std::ostream & per_class, const std::string & head, const std::vector<float> & thresholds, const std::vector<std::string> & class_entries) const
+    {
+        const size_t num_images = gt.size();
+
+        // rank of gt among top-k predictions, k if missed or unknown
+        std::vector<uint32_t> rank(num_images, (uint32_t)k);
+        std::vector<size_t> gt_count(num_classes, 0);
+        for (size_t i = 0; i < num_images; ++i)
+        {
+            if (gt[i] < 0 || (size_t)gt[i] >= num_classes)
+                continue;
+
+            ++gt_count[gt[i]];
+            for (size_t j = 0; j < k; ++j)
+                if (score[i * k + j] >= 0.f && idx[i * k + j] == (uint32_t)gt[i])
+                {
+                    rank[i] = (uint32_t)j;
+                    break;
+                }
+        }
+
+        // images by top-1 score, so every threshold only adds images to the accepted set
+        std::vector<size_t> order(num_images);
+        std::iota(order.begin(), order.end(), 0u);
+        std::sort(order.begin(), order.end(), [&](size_t l, size_t r) { return score[l * k] > score[r * k]; });
+
+        std::vector<float> thresh_desc(thresholds);
+        std::sort(thresh_desc.begin(), thresh_desc.end(), std::greater<float>());
+
+        size_t accepted = 0;
+        size_t accepted_labeled = 0;
+        std::vector<size_t> hits_at_rank(k + 1, 0);
+        std::vector<size_t> predicted(num_classes, 0);
+        std::vector<size_t> tp(num_classes, 0);
+
+        std::vector<std::string> summary_rows;
+        std::vector<std::string> class_rows;
+
+        auto ratio = [](size_t num, size_t den) { return den ? 1. * num / den : 0.; };
+
+        size_t pos = 0;
+        for (float t : thresh_desc)
+        {
+            for (; pos < num_images && score[order[pos] * k] >= t; ++pos)
+            {
+                size_t i = order[pos];
+                ++accepted;
+
+                if (gt[i] < 0 || (size_t)gt[i] >= num_classes)
+                    continue;
+
+                // precision is measured on labeled images only, as tp is
+                size_t top1 = idx[i * k];
+                if (top1 < num_classes)
+                    ++predicted[top1];
+
+                ++accepted_labeled;
+                ++hits_at_rank[rank[i]];
+                if (rank[i] == 0)
+                    ++tp[gt[i]];
+            }
+
+            std::string rows;
+            size_t correct = 0;
+            for (size_t j = 0; j < k; ++j)
+            {
+                correct += hits_at_rank[j];
+                rows += head + ',' + std::to_string(t) + ',' + std::to_string(j + 1) + ','
+                    + std::to_string(num_images) + ',' + std::to_string(accepted) + ',' + std::to_string(ratio(accepted, num_images)) + ','
+                    + std::to_string(accepted_labeled) + ',' + std::to_string(correct) + ',' + std::to_string(ratio(correct, accepted_labeled)) + '\n';
+            }
+            summary_rows.push_back(rows);
+
+            rows.clear();
+            for (size_t c = 0; c < num_classes; ++c)
+            {
+                if (!gt_count[c] && !predicted[c])
+                    continue;
+
+                const std::string & name = c < class_entries.size() ? class_entries[c] : std::to_string(c);
+                rows += head + ',' + std::to_string(t) + ',' + name + ','
+                    + std::to_string(gt_count[c]) + ',' + std::to_string(predicted[c]) + ',' + std::to_string(tp[c]) + ','
+                    + std::to_string(ratio(tp[c], predicted[c])) + ',' + std::to_string(ratio(tp[c], gt_count[c])) + '\n';
+            }
+            class_rows.push_back(rows);
+        }
+
+        // ascending thresholds in the output
+        for (auto it = summary_rows.rbegin(); it != summary_rows.rend(); ++it)
+            summary << *it;
+        for (auto it = class_rows.rbegin(); it != class_rows.rend(); ++it)
+            per_class << *it;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace clf
+{
+    /* keeps gt and top-k predictions of every image of a single head,
+    ** so accuracy / coverage / per-class precision and recall over a grid of thresholds and k
+    ** are computed after the run without another pass over the dataset */
+    class threshold_sweep_t
+    {
+    public:
+        threshold_sweep_t() {};
+        threshold_sweep_t(size_t num_classes, size_t topk);
+
+        /* <pred> is sorted by score, <gt> = -1 if unknown
+        ** not thread-safe */
+        void add(int gt, const std::vector<std::pair<size_t, float>> & pred);
+
+        /* appends images of <right>, both must have the same number of classes and k */
+        threshold_sweep_t & operator += (const threshold_sweep_t & right);
+
+        inline size_t size() const { return gt.size(); }
+        inline size_t topk() const { return k; }
+
+        /* summary:   head, thresh, k, images, accepted, coverage, labeled, correct, accuracy
+        ** per class: head, thresh, class, gt, predicted, tp, precision, recall (top-1)
+        ** an image is accepted if its top-1 score >= thresh, accuracy is over accepted labeled images */
+        void write_csv(std::ostream & summary, std::ostream & per_class, const std::string & head, const std::vector<float> & thresholds, const std::vector<std::string> & class_entries) const;
+
+        static void write_csv_header(std::ostream & summary, std::ostream & per_class);
+
+    private:
+        size_t num_classes = 0;
+        size_t k = 0;
+
+        // arena, <k> entries per image, unused entries have score -1
+        std::vector<int32_t> gt;
+        std::vector<uint32_t> idx;
+        std::vector<float> score;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,70 @@
+#include "crop_sweep.h"
+
+#include <algorithm>
+#include <string>
+
+namespace dt
+{
+    void crop_sweep_t::add(const float * rows, const std::vector<cmn::score_t> & keep, size_t row_size)
+    {
+        std::lock_guard<std::mutex> lg(mutex);
+        for (const auto & k : keep)
+        {
+            const float * row = rows + k.first * row_size;
+
+            det_t det;
+            det.score = k.second;
+            det.w = std::min(row[5], 1.f) - std::max(row[3], 0.f);
+            det.h = std::min(row[6], 1.f) - std::max(row[4], 0.f);
+            dets.push_back(det);
+        }
+        offsets.push_back(dets.size());
+    }
+
+    void crop_sweep_t::write_csv(std::ostream & out, const std::vector<float> & thresholds, const std::vector<float> & min_sizes, const std::vector<size_t> & max_objects) const
+    {
+        out << "thresh,min_size,max_objects,images,images_with_crops,crops\n";
+
+        const size_t num_images = size();
+        const size_t num_cells = min_sizes.size() * max_objects.size();
+
+        for (float t : thresholds)
+        {
+            std::vector<size_t> images_with_crops(num_cells, 0);
+            std::vector<size_t> crops(num_cells, 0);
+
+            for (size_t i = 0; i < num_images; ++i)
+            {
+                const det_t * first = dets.data() + offsets[i];
+                const det_t * last = dets.data() + offsets[i + 1];
+
+                // detections are sorted, those above the threshold are a prefix
+                size_t num_dets = 0;
+                while (first + num_dets != last && first[num_dets].score > t)
+                    ++num_dets;
+
+                for (size_t s = 0; s < min_sizes.size(); ++s)
+                    for (size_t m = 0; m < max_objects.size(); ++m)
+                    {
+                        size_t n = 0;
+                        size_t num_res = std::min(num_dets, max_objects[m]);
+                        for (size_t j = 0; j < num_res; ++j)
+                            if (first[j].w >= min_sizes[s] && first[j].h >= min_sizes[s])
+                                ++n;
+
+                        size_t cell = s * max_objects.size() + m;
+                        crops[cell] += n;
+                        images_with_crops[cell] += n ? 1 : 0;
+                    }
+            }
+
+            for (size_t s = 0; s < min_sizes.size(); ++s)
+                for (size_t m = 0; m < max_objects.size(); ++m)
+                {
+                    size_t cell = s * max_objects.size() + m;
+                    out << t << ',' << min_sizes[s] << ',' << max_objects[m] << ','
+                        << num_images << ',' << images_with_crops[cell] << ',' << crops[cell] << '\n';
+                }
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+#include "../common/topk.h"
+
+#include <mutex>
+#include <ostream>
+#include <vector>
+
+namespace dt
+{
+    /* keeps score and relative size of every detection above the lowest sweep threshold,
+    ** so the number of written crops over a grid of threshold x min size x max objects
+    ** is computed after the run without another pass over the dataset */
+    class crop_sweep_t
+    {
+    public:
+        crop_sweep_t() {};
+
+        void init(float min_thresh) { this->min_thresh = min_thresh; }
+        inline float threshold() const { return min_thresh; }
+
+        /* <rows> are raw detector rows [image_id, class_id, score, x_min, y_min, x_max, y_max],
+        ** <keep> are the rows selected at threshold(), sorted by score
+        ** thread-safe */
+        void add(const float * rows, const std::vector<cmn::score_t> & keep, size_t row_size);
+
+        inline size_t size() const { return offsets.size() - 1; }
+
+        /* thresh, min_size, max_objects, images, images_with_crops, crops
+        ** min_size applies to both relative width and height, as <min_width> and <min_height> do */
+        void write_csv(std::ostream & out, const std::vector<float> & thresholds, const std::vector<float> & min_sizes, const std::vector<size_t> & max_objects) const;
+
+    private:
+        struct det_t
+        {
+            float score;
+            float w, h;
+        };
+
+        float min_thresh = 0.f;
+
+        std::mutex mutex;
+        // arena, detections of image i are [offsets[i], offsets[i + 1]), sorted by score
+        std::vector<det_t> dets;
+        std::vector<size_t> offsets = { 0 };
+    };
+}
\ No newline at end of file
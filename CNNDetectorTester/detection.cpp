@@ -1,11 +1,14 @@
 #include "detection.h"
+#include "../common/hash.h"
+#include "../common/preprocess.h"
 
 #include <logger.h>
 
+#include <opencv2/imgproc.hpp>
+
 namespace detector
 {
     using LL = logger::LOG_LEVEL_t;
-    auto td_res_desc = [](const detector_t::det_res_t & l, const detector_t::det_res_t & r) { return l.prob > r.prob; };
 
     bool detector_t::init_params(const cv::CommandLineParser & cmd)
     {
@@ -26,8 +29,37 @@ namespace detector
         params.weights = path(cmd.get<std::string>("weights"));
 
         params.image_size = cmd.get<size_t>("image_size");
+        params.replicas = std::max<size_t>(cmd.get<size_t>("replicas"), 1u);
 
         params.thresh = cmd.has("threshold") ? cmd.get<float>("threshold") : 0.f;
+        params.nms.iou = cmd.get<float>("nms");
+        params.nms.soft = cmd.get<int>("soft_nms") == 0 ? false : true;
+        params.nms.sigma = cmd.get<float>("soft_nms_sigma");
+        params.nms.top_k = cmd.get<size_t>("top_k");
+        if (params.nms.soft && (params.nms.sigma <= 0.f || params.nms.iou <= 0.f))
+        {
+            logger::LOG_MSG(LL::Error, "Wrong values <soft_nms>=1 requires <nms> > 0 and <soft_nms_sigma> > 0.");
+            retval = false;
+        }
+
+        if (cmd.get<int>("profile_layers") != 0)
+            profiler.init(cmd.get<size_t>("profile_warmup"));
+
+        params.tile_size = cmd.get<size_t>("tile_size");
+        params.tile_stride = cmd.get<size_t>("tile_stride");
+        params.tile_full = cmd.get<int>("tile_full") == 0 ? false : true;
+        params.tile_skip_std = cmd.get<double>("tile_skip_std");
+        if (params.tile_size)
+        {
+            if (!params.tile_stride)
+                params.tile_stride = params.tile_size * 3 / 4;
+            if (params.tile_stride > params.tile_size)
+            {
+                logger::LOG_MSG(LL::Error, "Wrong value <tile_stride> > <tile_size>, objects between tiles would be missed.");
+                retval = false;
+            }
+            params.nms.tile_merge = cmd.get<float>("tile_merge");
+        }
 
         return retval;
     }
@@ -40,17 +72,14 @@ namespace detector
         msg << "\nTraffic detector: \n";
         msg
             << "Model: " << params.model << '\n'
-            << "Config: " << params.weights;
+            << "Config: " << params.weights << '\n'
+            << "Replicas: " << params.replicas;
 
         logger::LOG_MSG(LL::Info, msg.str());
 
         try
         {
-            net = cv::dnn::readNet(params.model.string(), params.weights.string());
-            net.setPreferableBackend(cv::dnn::DNN_BACKEND_DEFAULT);
-            net.setPreferableTarget(cv::dnn::DNN_TARGET_CPU);
-
-            if (net.empty())
+            if (!net.load(params.model.string(), params.weights.string(), params.replicas, cv::dnn::DNN_BACKEND_DEFAULT, cv::dnn::DNN_TARGET_CPU))
             {
                 logger::LOG_MSG(LL::Error, "Failed to load detector.");
                 return false;
@@ -72,39 +101,238 @@ namespace detector
     }
 
     void detector_t::process_file(const cv::Mat & img, std::vector<det_res_t> & results)
+    {
+        std::vector<std::vector<det_res_t>> batch_results(1);
+        process_batch({ img }, batch_results);
+        results = std::move(batch_results[0]);
+    }
+
+    void detector_t::process_batch(const std::vector<cv::Mat> & imgs, std::vector<std::vector<det_res_t>> & results)
+    {
+        if (imgs.empty())
+            return;
+
+        std::vector<std::vector<float>> rows;
+        forward_batch(imgs, rows);
+
+        results.resize(imgs.size());
+        for (size_t i = 0; i < imgs.size(); ++i)
+            process_output(rows[i].data(), rows[i].size() / ROW_SIZE, imgs[i].size(), results[i]);
+    }
+
+    void detector_t::forward_batch(const std::vector<cv::Mat> & imgs, std::vector<std::vector<float>> & rows)
     {
         // detector
-        cv::Mat detBlob = cv::dnn::blobFromImage(img,
-            params.scale_factor,
-            cv::Size((int)params.image_size, (int)params.image_size),
-            params.mean,
-            params.inverse_channels,
-            params.crop,
-            params.ddepth);
+        cmn::preprocess_param_t pre;
+        pre.size = cv::Size((int)params.image_size, (int)params.image_size);
+        pre.scale_factor = params.scale_factor;
+        pre.mean = params.mean;
+        pre.swap_RB = params.inverse_channels;
+        pre.crop = params.crop;
+        pre.ddepth = params.ddepth;
 
-        net.setInput(detBlob);
+        // reused by every batch processed on this thread
+        thread_local std::vector<cv::Mat> inputs;
+        thread_local std::vector<cv::Rect> rects;
+        thread_local std::vector<size_t> owners;
+        thread_local cv::Mat detBlob;
+        {
+            cmn::stage_timers_t::scope_t t(timers, preprocess_stage);
+            inputs.clear();
+            rects.clear();
+            owners.clear();
+            for (size_t i = 0; i < imgs.size(); ++i)
+            {
+                tile_frame(imgs[i], inputs, rects);
+                owners.resize(inputs.size(), i);
+            }
+
+            rows.assign(imgs.size(), std::vector<float>());
+            if (inputs.empty())
+                return;
+
+            cmn::blob_from_images(inputs, detBlob, pre);
+        }
 
-        cv::Mat output = net.forward();
+        cv::Mat output;
+        {
+            // includes waiting for a free replica
+            cmn::stage_timers_t::scope_t t(timers, forward_stage);
+            auto lease = net.acquire();
+            lease.net().setInput(detBlob);
 
+            // output blob shares memory with the replica, copy it before it is released
+            output = lease.net().forward().clone();
+            // tiles are separate network inputs
+            if (profiler.enabled())
+                profiler.add(lease.net(), lease.id(), inputs.size());
+        }
+
+        /* SSD-style output [1, 1, N, 7], each row is
+        ** [image_id, class_id, score, x_min, y_min, x_max, y_max] for all images in the batch */
         cv::Mat reshaped{ output.size[2], output.size[3], CV_32F, output.ptr<float>() };
 
         for (int i = 0; i < (int)reshaped.rows; ++i)
         {
-            float score = reshaped.at<float>(i, 2);
-            if (score > params.thresh)
+            const float * row = reshaped.ptr<float>(i);
+            int input_id = (int)row[0];
+            if (input_id < 0 || input_id >= (int)inputs.size())
+                continue;
+
+            const cv::Size frame = imgs[owners[input_id]].size();
+            const cv::Rect & rect = rects[input_id];
+            std::vector<float> & img_rows = rows[owners[input_id]];
+
+            if (rect.size() == frame)
+            {
+                img_rows.insert(img_rows.end(), row, row + ROW_SIZE);
+                continue;
+            }
+
+            // a box reaching a tile side that is not a frame side is a part of an object cut by the tile
+            const float CUT_MARGIN = 0.01f;
+            bool cut = (rect.x > 0 && row[3] <= CUT_MARGIN) ||
+                (rect.y > 0 && row[4] <= CUT_MARGIN) ||
+                (rect.x + rect.width < frame.width && row[5] >= 1.f - CUT_MARGIN) ||
+                (rect.y + rect.height < frame.height && row[6] >= 1.f - CUT_MARGIN);
+
+            // tile coordinates to frame coordinates, both normalized
+            float sx = 1.f * rect.width / frame.width;
+            float sy = 1.f * rect.height / frame.height;
+            float ox = 1.f * rect.x / frame.width;
+            float oy = 1.f * rect.y / frame.height;
+            float mapped[ROW_SIZE] = { encode_input_id(input_id, cut), row[1], row[2], ox + row[3] * sx, oy + row[4] * sy, ox + row[5] * sx, oy + row[6] * sy };
+            img_rows.insert(img_rows.end(), mapped, mapped + ROW_SIZE);
+        }
+    }
+
+    void detector_t::tile_frame(const cv::Mat & img, std::vector<cv::Mat> & inputs, std::vector<cv::Rect> & rects) const
+    {
+        const int tile = (int)params.tile_size;
+        const cv::Rect frame(0, 0, img.cols, img.rows);
+
+        if (!tile || (img.cols <= tile && img.rows <= tile))
+        {
+            inputs.push_back(img);
+            rects.push_back(frame);
+            return;
+        }
+
+        if (params.tile_full)
+        {
+            inputs.push_back(img);
+            rects.push_back(frame);
+        }
+
+        // the last tile of a row / column is aligned to the frame border
+        auto offsets = [&](int size, std::vector<int> & out)
+        {
+            out.clear();
+            for (int o = 0; ; o += (int)params.tile_stride)
             {
-                det_res_t result;
-                result.class_id = (unsigned int)reshaped.at<float>(i, 1);
-                result.x = std::max(0, int(reshaped.at<float>(i, 3) * img.cols));
-                result.y = std::max(0, int(reshaped.at<float>(i, 4) * img.rows));
-                result.w = std::max(0, int(reshaped.at<float>(i, 5) * img.cols - result.x));
-                result.h = std::max(0, int(reshaped.at<float>(i, 6) * img.rows - result.y));
-                result.prob = score;
-
-                results.push_back(result);
+                if (o + tile >= size)
+                {
+                    out.push_back(std::max(0, size - tile));
+                    break;
+                }
+                out.push_back(o);
             }
+        };
+        thread_local std::vector<int> xs, ys;
+        offsets(img.cols, xs);
+        offsets(img.rows, ys);
+
+        /* uniformity is checked on a sparse sample of the frame, ~32 px per tile side,
+        ** so skipping costs a fraction of a single forward pass */
+        const int step = std::max(1, tile / 32);
+        thread_local cv::Mat sample;
+        if (params.tile_skip_std > 0.)
+            cv::resize(img, sample, cv::Size(), 1. / step, 1. / step, cv::INTER_NEAREST);
+
+        for (int y : ys)
+            for (int x : xs)
+            {
+                cv::Rect rect = cv::Rect(x, y, tile, tile) & frame;
+
+                if (params.tile_skip_std > 0.)
+                {
+                    cv::Rect sample_rect = cv::Rect(rect.x / step, rect.y / step, std::max(1, rect.width / step), std::max(1, rect.height / step)) & cv::Rect(0, 0, sample.cols, sample.rows);
+                    cv::Scalar mean, stddev;
+                    cv::meanStdDev(sample(sample_rect), mean, stddev);
+                    if (std::max(std::max(stddev[0], stddev[1]), stddev[2]) < params.tile_skip_std)
+                        continue;
+                }
+
+                inputs.push_back(img(rect));
+                rects.push_back(rect);
+            }
+    }
+
+    void detector_t::select_rows(const float * rows, size_t num_rows, float thresh, std::vector<cmn::score_t> & keep) const
+    {
+        select_detections(rows, num_rows, ROW_SIZE, thresh, params.nms, keep);
+    }
+
+    void detector_t::process_output(const float * rows, size_t num_rows, const cv::Size & img_size, std::vector<det_res_t> & results) const
+    {
+        // reused by every image processed on this thread
+        thread_local std::vector<cmn::score_t> keep;
+        select_rows(rows, num_rows, params.thresh, keep);
+
+        results.clear();
+        results.reserve(keep.size());
+        for (const auto & k : keep)
+        {
+            const float * row = rows + k.first * ROW_SIZE;
+
+            det_res_t result;
+            result.class_id = (unsigned int)row[1];
+            std::copy(row + 3, row + 7, result.box);
+            set_pixel_box(result, img_size);
+            result.prob = k.second;
+
+            results.push_back(result);
         }
+    }
+
+    void detector_t::set_pixel_box(det_res_t & res, const cv::Size & img_size)
+    {
+        res.x = std::max(0, int(res.box[0] * img_size.width));
+        res.y = std::max(0, int(res.box[1] * img_size.height));
+        res.w = std::max(0, int(res.box[2] * img_size.width - res.x));
+        res.h = std::max(0, int(res.box[3] * img_size.height - res.y));
+    }
+
+    void detector_t::print_profile()
+    {
+        if (!profiler.enabled() || net.empty())
+            return;
+
+        auto lease = net.acquire();
+        profiler.print(lease.net(), { 1, 3, (int)params.image_size, (int)params.image_size }, params.model.filename().string());
+    }
+
+    void detector_t::attach_timers(cmn::stage_timers_t & timers)
+    {
+        this->timers = &timers;
+        preprocess_stage = timers.add("preprocess");
+        forward_stage = timers.add("forward");
+    }
+
+    uint64_t detector_t::model_hash() const
+    {
+        uint64_t model = 0;
+        uint64_t weights = 0;
+        cmn::file_hash(params.model.string(), model);
+        cmn::file_hash(params.weights.string(), weights);
+
+        std::stringstream pre;
+        pre << params.image_size << ' ' << params.scale_factor << ' '
+            << params.mean[0] << ' ' << params.mean[1] << ' ' << params.mean[2] << ' ' << params.mean[3] << ' '
+            << params.inverse_channels << ' ' << params.crop << ' ' << params.ddepth;
+        if (params.tile_size)
+            pre << " tiles " << params.tile_size << ' ' << params.tile_stride << ' ' << params.tile_full << ' ' << params.tile_skip_std;
 
-        std::sort(results.begin(), results.end(), td_res_desc);
+        return cmn::hash_combine(cmn::hash_combine(model, weights), cmn::hash64(pre.str()));
     }
 }
\ No newline at end of file
@@ -1,7 +1,13 @@
 #pragma once
 
+#include "postprocess.h"
+#include "../common/layer_profiler.h"
+#include "../common/net_pool.h"
+#include "../common/stage_timers.h"
+
 #include <opencv2/dnn.hpp>
 
+#include <cstdint>
 #include <filesystem>
 
 namespace detector
@@ -12,7 +18,9 @@ namespace detector
     {
         detector_t() {}
 
-        cv::dnn::Net net;
+        cmn::net_pool_t net;
+        /* enabled by <profile_layers> */
+        cmn::layer_profiler_t profiler;
 
         struct param_t
         {
@@ -20,7 +28,16 @@ namespace detector
             path model;
             path weights;
             size_t image_size;
+            size_t replicas;
             float thresh;
+            nms_param_t nms;
+            /* frames larger than <tile_size> px are also run as overlapping tiles, 0 - disabled */
+            size_t tile_size = 0;
+            size_t tile_stride = 0;
+            /* besides the tiles, the whole frame is run to keep objects larger than a tile */
+            bool tile_full = true;
+            /* tiles with max channel stddev below it are skipped, 0 - disabled */
+            double tile_skip_std = 0.;
 
             double scale_factor = 1.;
             cv::Scalar mean = cv::Scalar(0, 0, 0);
@@ -36,11 +53,41 @@ namespace detector
             int x, y;
             int w, h;
             float prob;
+            /* normalized [x_min, y_min, x_max, y_max] as output by the network, independent of the decoded size */
+            float box[4];
         };
 
+        /* [image_id, class_id, score, x_min, y_min, x_max, y_max] */
+        static const size_t ROW_SIZE = 7;
+
         bool init_params(const cv::CommandLineParser & cmd);
         bool load_detector();
+        /* identity of model, weights and preprocessing, for caching raw outputs */
+        uint64_t model_hash() const;
 
         void process_file(const cv::Mat & img, std::vector<det_res_t> & results);
+        /* single forward pass over the batch, results are scattered to the same positions as <imgs> */
+        void process_batch(const std::vector<cv::Mat> & imgs, std::vector<std::vector<det_res_t>> & results);
+        /* single forward pass, <rows> holds raw output rows (ROW_SIZE floats each) per image, unfiltered
+        ** in tiled mode rows of every tile are mapped to frame coordinates, image_id is the tile id, see encode_input_id() */
+        void forward_batch(const std::vector<cv::Mat> & imgs, std::vector<std::vector<float>> & rows);
+        /* applies threshold, top-k pre-cut and NMS to raw rows, coordinates relative to <img_size>, sorted by prob */
+        void process_output(const float * rows, size_t num_rows, const cv::Size & img_size, std::vector<det_res_t> & results) const;
+        /* x, y, w, h of <res> from its normalized box for an image of <img_size> */
+        static void set_pixel_box(det_res_t & res, const cv::Size & img_size);
+        /* same selection at an arbitrary threshold, (row index, score) */
+        void select_rows(const float * rows, size_t num_rows, float thresh, std::vector<cmn::score_t> & keep) const;
+        /* appends network inputs of <img> to <inputs>: the frame itself if it fits into a tile or <tile_full> is set,
+        ** and its non-uniform tiles, <rects> are their positions in the frame */
+        void tile_frame(const cv::Mat & img, std::vector<cv::Mat> & inputs, std::vector<cv::Rect> & rects) const;
+        /* per-layer times collected by <profile_layers>, FLOPs and memory for a single <image_size> input */
+        void print_profile();
+        /* times tiling / preprocessing and forward passes of forward_batch() as preprocess / forward */
+        void attach_timers(cmn::stage_timers_t & timers);
+
+    private:
+        cmn::stage_timers_t * timers = nullptr;
+        size_t preprocess_stage = 0;
+        size_t forward_stage = 0;
     };
 }
\ No newline at end of file
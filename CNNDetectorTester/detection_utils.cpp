@@ -1,14 +1,25 @@
 #include "detection_utils.h"
+#include "../common/archive_reader.h"
+#include "../common/dir_cache.h"
+#include "../common/hash.h"
+#include "../common/image_io.h"
+#include "../common/manifest.h"
+#include "../common/progress_reporter.h"
+#include "../common/shard_writer.h"
+#include "../common/stage_timers.h"
 
 #include <filetree_rambler.h>
 #include <file_utils.h>
 
 #include <opencv2/imgcodecs.hpp>
 #include <opencv2/imgproc.hpp>
+#include <opencv2/videoio.hpp>
 #ifdef WITH_OPENCV_HIGHGUI
 #include <opencv2/highgui.hpp>
 #endif // WITH_OPENCV_HIGHGUI
 
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <fstream>
 
@@ -18,6 +29,60 @@ namespace dt
 
     static detector::detector_t detector;
     static param_t params;
+    static cmn::pipeline_t<det_task_t> pipeline;
+    static cmn::result_cache_t cache;
+    static uint64_t model_key = 0;
+    static std::atomic<size_t> cache_hits(0);
+
+    /* cache record: [frame_width, frame_height, decode_factor], raw detector rows */
+    const size_t FRAME_PART_SIZE = 3;
+
+    static crop_sweep_t sweep;
+
+    static clf::classifier_t classifier;
+    static std::mutex cascade_out_mutex;
+    static std::ofstream cascade_out;
+
+    static annotations_t annotations;
+    static evaluator_t evaluator;
+
+    static const std::vector<std::string> IMAGE_EXT = { ".jpg", ".jpeg", ".png", ".bmp" };
+    static const std::vector<std::string> VIDEO_EXT = { ".mp4", ".avi", ".mkv", ".mov" };
+    static std::atomic<size_t> key_frames(0);
+    static std::atomic<size_t> reused_frames(0);
+
+    static cmn::dir_cache_t out_dirs;
+    static cmn::shard_writer_t shards;
+
+    static cmn::stage_timers_t timers;
+    static cmn::progress_reporter_t reporter;
+    /* timer ids in pipeline order, preprocess / forward are registered by the detector and the cascade classifier */
+    static struct
+    {
+        size_t scan, enqueue, read, decode, postprocess, encode, write;
+    } stage;
+    /* end of the previous push, the crawler is single-threaded */
+    static cmn::stage_timers_t::timer_clock_t::time_point scan_mark;
+
+    /* "0.3,0.5,0.7" */
+    template <typename T>
+    static bool parse_list(const std::string & str, std::vector<T> & list)
+    {
+        list.clear();
+
+        std::stringstream ss(str);
+        std::string item;
+        while (std::getline(ss, item, ','))
+        {
+            std::stringstream item_ss(item);
+            T value;
+            if (!(item_ss >> value))
+                return false;
+            list.push_back(value);
+        }
+
+        return !list.empty();
+    }
 
     bool init_params(const cv::CommandLineParser & cmd)
     {
@@ -38,6 +103,15 @@ namespace dt
             retval = false;
         }
 
+        params.manifest = path(cmd.get<std::string>("manifest"));
+        params.manifest_refresh = cmd.get<int>("manifest_refresh") == 0 ? false : true;
+        params.manifest_only = cmd.get<int>("manifest_only") == 0 ? false : true;
+        if (params.manifest_only && params.manifest.empty())
+        {
+            logger::LOG_MSG(LL::Error, "<manifest_only>=1 requires <manifest>.");
+            retval = false;
+        }
+
         int outdir_mode = cmd.get<int>("outdir_mode");
         if (outdir_mode < -1 || outdir_mode > 1)
         {
@@ -46,7 +120,7 @@ namespace dt
         }
         params.outdir_mode = outdir_mode;
 
-        if (outdir_mode != -1 && !cmd.has("outdir"))
+        if (outdir_mode != -1 && !cmd.has("outdir") && !params.manifest_only)
         {
             logger::LOG_MSG(LL::Error, "<outdir> must be specified.");
             retval = false;
@@ -54,10 +128,43 @@ namespace dt
         params.outdir = path(cmd.get<std::string>("outdir"));
 
         params.move_out = cmd.get<int>("move_out") == 0 ? false : true;
+        params.reduced_decode = cmd.get<int>("reduced_decode") == 0 ? false : true;
+        params.archives = cmd.get<int>("archives") == 0 ? false : true;
+        params.shard_size = cmd.get<size_t>("shard_size");
+        if (params.move_out && params.shard_size)
+        {
+            // shards are written asynchronously, a source removed before its shard is on disk could be lost
+            logger::LOG_MSG(LL::Error, "<move_out>=1 can not be combined with <shard_size>.");
+            retval = false;
+        }
+        params.cache = path(cmd.get<std::string>("cache"));
+        params.timing_json = path(cmd.get<std::string>("timing_json"));
+        params.progress_interval = cmd.get<size_t>("progress_interval");
+        params.progress_json = path(cmd.get<std::string>("progress_json"));
+
+        params.sweep = path(cmd.get<std::string>("sweep"));
+        if (!params.sweep.empty())
+        {
+            if (!parse_list(cmd.get<std::string>("sweep_thresh"), params.sweep_thresh) ||
+                !parse_list(cmd.get<std::string>("sweep_min_size"), params.sweep_min_size) ||
+                !parse_list(cmd.get<std::string>("sweep_max_objects"), params.sweep_max_objects))
+            {
+                logger::LOG_MSG(LL::Error, "Wrong values <sweep_thresh>, <sweep_min_size> or <sweep_max_objects>. Comma separated lists expected.");
+                retval = false;
+            }
+            else
+                sweep.init(*std::min_element(params.sweep_thresh.begin(), params.sweep_thresh.end()));
+        }
 
         params.min_height = cmd.get<double>("min_height");
         params.min_width = cmd.get<double>("min_width");
         params.max_objects = cmd.get<size_t>("max_objects");
+        params.pipeline.decode_threads = std::max<size_t>(cmd.get<size_t>("decode_threads"), 1u);
+        params.pipeline.infer_threads = cmd.get<size_t>("infer_threads");
+        params.pipeline.encode_threads = std::max<size_t>(cmd.get<size_t>("encode_threads"), 1u);
+        params.pipeline.queue_size = std::max<size_t>(cmd.get<size_t>("queue_size"), 1u);
+        params.pipeline.batch_size = std::max<size_t>(cmd.get<size_t>("batch_size"), 1u);
+        params.pipeline.batch_wait = std::chrono::milliseconds(cmd.get<size_t>("batch_wait"));
 
 #       ifdef WITH_OPENCV_HIGHGUI
             params.dbg = cmd.get<bool>("debug_win");
@@ -67,16 +174,183 @@ namespace dt
                 logger::LOG_MSG(LL::Warning, "Wrong values possible. <outdir_mode>=-1 and <recheck_falses>=-1 and <debug_win>=-1 the program will run without any output and effect.");
 #       endif // WITH_OPENCV_HIGHGUI
 
+        params.cascade = cmd.get<int>("cascade") == 0 ? false : true;
+        params.cascade_out = path(cmd.get<std::string>("cascade_out"));
+
+        params.eval = cmd.get<int>("eval") == 0 ? false : true;
+        params.eval_pr = path(cmd.get<std::string>("eval_pr"));
+        if (params.eval)
+        {
+            std::string gt_format = cmd.get<std::string>("gt_format");
+            std::vector<float> eval_iou;
+            if (gt_format != "voc" && gt_format != "csv")
+            {
+                logger::LOG_MSG(LL::Error, "Wrong value <gt_format>=" + gt_format + ". Allowed values: voc, csv.");
+                retval = false;
+            }
+            else if (!annotations.init(gt_format == "voc" ? annotations_t::VOC : annotations_t::CSV,
+                path(cmd.get<std::string>("gt_dir")), params.indir, path(cmd.get<std::string>("labels"))))
+                retval = false;
+
+            if (!parse_list(cmd.get<std::string>("eval_iou"), eval_iou))
+            {
+                logger::LOG_MSG(LL::Error, "Wrong value <eval_iou>. Comma separated list expected.");
+                retval = false;
+            }
+            else
+                evaluator.init(eval_iou, annotations.labels());
+
+            if (cmd.has("threshold") && cmd.get<float>("threshold") > 0.05f)
+                logger::LOG_MSG(LL::Warning, "AP is underestimated with a high <threshold>, detections below it never reach the PR curve. Consider <threshold>=0.01.");
+        }
+        params.video = cmd.get<int>("video") == 0 ? false : true;
+        params.video_stride = std::max<size_t>(cmd.get<size_t>("video_stride"), 1u);
+        params.video_scene_diff = cmd.get<double>("video_scene_diff");
+        params.video_max_reuse = cmd.get<size_t>("video_max_reuse");
+
+        // crawling only, no model is loaded
+        if (params.manifest_only)
+            return retval;
+
         if (retval)
             retval = detector.init_params(cmd) && detector.load_detector();
 
+        if (retval && detector.params.tile_size && params.reduced_decode)
+        {
+            logger::LOG_MSG(LL::Warning, "<reduced_decode>=1 is ignored in tiled mode, tiles are cut from full resolution frames.");
+            params.reduced_decode = false;
+        }
+
+        if (retval && params.eval && params.reduced_decode)
+        {
+            logger::LOG_MSG(LL::Warning, "<reduced_decode>=1 is ignored in evaluation mode, ground truth refers to the original image size.");
+            params.reduced_decode = false;
+        }
+
+        if (retval && params.cascade)
+        {
+            retval = classifier.init_params(cmd, "clf_") && classifier.load_classifier();
+            // crops have no ground truth in their names
+            classifier.params.check_filename = false;
+
+            if (params.reduced_decode)
+            {
+                logger::LOG_MSG(LL::Warning, "<reduced_decode>=1 is ignored in cascade mode, objects are classified at full resolution.");
+                params.reduced_decode = false;
+            }
+
+            if (!params.cascade_out.empty())
+            {
+                cascade_out.open(params.cascade_out.string());
+                if (!cascade_out.is_open())
+                {
+                    logger::LOG_MSG(LL::Error, "Failed to open " + params.cascade_out.string());
+                    retval = false;
+                }
+                else
+                    cascade_out << "file,frame,object,x,y,w,h,prob,class_id,labels\n";
+            }
+        }
+
+        if (retval)
+        {
+            stage.scan = timers.add("scan");
+            stage.enqueue = timers.add("enqueue_wait");
+            stage.read = timers.add("read");
+            stage.decode = timers.add("decode");
+            detector.attach_timers(timers);
+            stage.postprocess = timers.add("postprocess");
+            if (params.cascade)
+                classifier.attach_timers(timers, "clf_");
+            stage.encode = timers.add("encode");
+            stage.write = timers.add("write");
+        }
+
+        if (retval && !params.cache.empty())
+        {
+            // reduced decode feeds the net with different pixels, so it is a part of the model identity
+            model_key = cmn::hash_combine(detector.model_hash(), params.reduced_decode ? 1u : 0u);
+            if (!cache.open(params.cache.string()))
+            {
+                logger::LOG_MSG(LL::Error, "Failed to open result cache: " + params.cache.string());
+                retval = false;
+            }
+            else
+                logger::LOG_MSG(LL::Info, "Result cache: " + params.cache.string() + ", " + std::to_string(cache.size()) + " records.");
+        }
+
+        // by default one inference thread per network replica
+        if (params.pipeline.infer_threads == 0)
+            params.pipeline.infer_threads = detector.params.replicas;
+
         return retval;
     }
     
+    static bool has_ext(const path & file, const std::vector<std::string> & ext_list)
+    {
+        return std::find(ext_list.begin(), ext_list.end(), cmn::lower_ext(file.string())) != ext_list.end();
+    }
+
+    /* builds <manifest> on the first run, re-lists directories whose mtime changed on <manifest_refresh> */
+    static bool update_manifest(const ftr::settings_t & scan)
+    {
+        namespace fs = std::experimental::filesystem::v1;
+        if (!fs::is_directory(params.indir))
+        {
+            logger::LOG_MSG(LL::Error, "<manifest> requires <indir> to be a directory: " + params.indir.string());
+            return false;
+        }
+
+        cmn::manifest_t::settings_t settings;
+        settings.ext_list = scan.ext_list;
+        settings.check_subdirs = scan.check_subdirs;
+        settings.max_subdir_depth = scan.max_subdir_depth;
+
+        bool exists = fs::exists(params.manifest);
+        if (exists && !cmn::manifest_t::same_scan(params.manifest.string(), settings))
+            logger::LOG_MSG(LL::Info, "Manifest was crawled with other scan settings, it is rebuilt: " + params.manifest.string());
+        else if (exists && !params.manifest_refresh)
+            return true;
+
+        auto start = std::chrono::steady_clock::now();
+        if (!cmn::manifest_t::build(params.indir, settings, params.manifest.string(), exists))
+        {
+            logger::LOG_MSG(LL::Error, "Failed to write manifest: " + params.manifest.string());
+            return false;
+        }
+
+        double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        logger::LOG_MSG(LL::Info, std::string(exists ? "Manifest is refreshed in " : "Manifest is built in ") + std::to_string(sec) + " s: " + params.manifest.string());
+        return true;
+    }
+
     void process_dir()
     {
+        ftr::settings_t settings;
+        settings.check_subdirs = (params.indir_mode != 0);
+        settings.max_subdir_depth = (params.indir_mode == -1 ? 0u : (size_t)params.indir_mode);
+        settings.ext_list = IMAGE_EXT;
+        if (params.archives)
+            settings.ext_list.insert(settings.ext_list.end(), { ".tar", ".zip" });
+        if (params.video)
+            settings.ext_list.insert(settings.ext_list.end(), VIDEO_EXT.begin(), VIDEO_EXT.end());
+        // the crawler only feeds the pipeline, decoding is done by the decode pool
+        settings.max_threads = 1u;
+
+        if (!params.manifest.empty() && !update_manifest(settings))
+            return;
+        if (params.manifest_only)
+            return;
+
         if (params.outdir_mode != -1)
+        {
             ftr::create_dir(params.outdir);
+            if (params.shard_size && !shards.open(params.outdir.string(), "crops", (uint64_t)params.shard_size << 20, params.pipeline.queue_size))
+            {
+                logger::LOG_MSG(LL::Error, "Failed to open output shards in " + params.outdir.string());
+                return;
+            }
+        }
 
 #       ifdef WITH_OPENCV_HIGHGUI
             if (params.recheck_falses)
@@ -87,24 +361,493 @@ namespace dt
                 "Press SPACE to save image / crop to output, ENTER to skip");
 #       endif // WITH_OPENCV_HIGHGUI
 
-        ftr::settings_t settings;
-        settings.check_subdirs = (params.indir_mode != 0);
-        settings.max_subdir_depth = (params.indir_mode == -1 ? 0u : (size_t)params.indir_mode);
-        settings.ext_list = { ".jpg", ".jpeg", ".png", ".bmp" };
+        cmn::pipeline_settings_t pipeline_settings = params.pipeline;
 #       ifdef WITH_OPENCV_HIGHGUI
             if (params.dbg || params.recheck_falses)
-                settings.max_threads = 1u; // TODO: check cv::waitkey() threadsafety
-            else
-                settings.max_threads = 16u;
-#       else
-        settings.max_threads = 16u;
+            {
+                // TODO: check cv::waitkey() threadsafety
+                pipeline_settings.encode_threads = 1u;
+                pipeline_settings.batch_size = 1u;
+            }
 #       endif // WITH_OPENCV_HIGHGUI
 
-        ftr::scan(params.indir, process_file, settings);
+        timers.start();
+        scan_mark = cmn::stage_timers_t::timer_clock_t::now();
+        pipeline.start(pipeline_settings, decode_file, infer_batch, encode_file, fail_task);
+        reporter.add_gauge("decode", []() { return pipeline.decode_queue_size(); });
+        reporter.add_gauge("infer", []() { return pipeline.infer_queue_size(); });
+        reporter.add_gauge("encode", []() { return pipeline.encode_queue_size(); });
+        reporter.start(std::chrono::seconds(params.progress_interval), 0, params.progress_json.string());
+        if (cmn::archive_reader_t::is_archive(params.indir.string()) && !std::experimental::filesystem::v1::is_directory(params.indir))
+            enqueue_archive(params.indir);
+        else if (!params.manifest.empty())
+        {
+            std::mutex scan_mutex;
+            // the manifest may be built with other input options
+            bool complete = cmn::manifest_t::read(params.manifest.string(), params.indir, 0,
+                [&](const path & file, const cmn::manifest_t::entry_t & /* entry */)
+                {
+                    if (has_ext(file, settings.ext_list))
+                        enqueue_file(file, scan_mutex);
+                });
+            if (!complete)
+                logger::LOG_MSG(LL::Warning, "Manifest is damaged, only its readable part is processed: " + params.manifest.string());
+        }
+        else
+            ftr::scan(params.indir, enqueue_file, settings);
+        reporter.scan_finished();
+        pipeline.finish();
+        reporter.stop();
+        timers.stop();
+
+        if (shards.is_open())
+        {
+            shards.close();
+            logger::LOG_MSG(LL::Info, "Crops written: " + std::to_string(shards.members()) + " in " + std::to_string(shards.shards()) + " shards.");
+        }
+
+        if (cache.is_open())
+            logger::LOG_MSG(LL::Info, "Result cache hits: " + std::to_string(cache_hits.load()));
+
+        if (params.video)
+            logger::LOG_MSG(LL::Info, "Video frames detected: " + std::to_string(key_frames.load()) + ", reused detections: " + std::to_string(reused_frames.load()));
+
+        if (!params.sweep.empty())
+        {
+            std::ofstream out(params.sweep.string());
+            if (!out.is_open())
+                logger::LOG_MSG(LL::Error, "Failed to open " + params.sweep.string());
+            else
+            {
+                sweep.write_csv(out, params.sweep_thresh, params.sweep_min_size, params.sweep_max_objects);
+                logger::LOG_MSG(LL::Info, "Crop yield sweep is saved to " + params.sweep.string());
+            }
+        }
+
+        // crops have no ground truth, so there is no accuracy, only what the cascade predicted and its coverage
+        if (params.cascade)
+        {
+            classifier.merge_stat();
+            classifier.print_predictions();
+            classifier.save_sweep();
+        }
+
+        if (params.eval)
+        {
+            evaluator.report();
+            if (!params.eval_pr.empty() && evaluator.save_pr(params.eval_pr))
+                logger::LOG_MSG(LL::Info, "PR curves are saved to " + params.eval_pr.string());
+        }
+
+        detector.print_profile();
+        if (params.cascade)
+            classifier.print_profile();
+
+        timers.print();
+        if (!params.timing_json.empty())
+        {
+            if (timers.save_json(params.timing_json.string()))
+                logger::LOG_MSG(LL::Info, "Stage timings are saved to " + params.timing_json.string());
+            else
+                logger::LOG_MSG(LL::Error, "Failed to write " + params.timing_json.string());
+        }
+    }
+
+    /* crawler time since the previous push, then the time blocked on a full decode queue */
+    static void push_task(std::unique_ptr<det_task_t> task)
+    {
+        auto now = cmn::stage_timers_t::timer_clock_t::now();
+        timers.record(stage.scan, now - scan_mark);
+        reporter.add_enqueued();
+        pipeline.push(std::move(task));
+        scan_mark = cmn::stage_timers_t::timer_clock_t::now();
+        timers.record(stage.enqueue, scan_mark - now);
+    }
+
+    void enqueue_file(const path & file, std::mutex & /* scan_mutex */)
+    {
+        if (params.video && has_ext(file, VIDEO_EXT))
+        {
+            enqueue_video(file);
+            return;
+        }
+
+        if (params.archives && cmn::archive_reader_t::is_archive(file.string()))
+        {
+            enqueue_archive(file);
+            return;
+        }
+
+        std::unique_ptr<det_task_t> task(new det_task_t);
+        task->file = file;
+        push_task(std::move(task));
+    }
+
+    void enqueue_archive(const path & archive)
+    {
+        cmn::archive_reader_t reader;
+        if (!reader.open(archive.string(), params.pipeline.queue_size))
+        {
+            logger::LOG_MSG(LL::Warning, "Failed to open archive: " + archive.string());
+            return;
+        }
+
+        cmn::archive_reader_t::member_t member;
+        while (reader.next(member))
+        {
+            path file = archive / member.name;
+            if (!has_ext(file, IMAGE_EXT))
+                continue;
+
+            std::unique_ptr<det_task_t> task(new det_task_t);
+            task->file = file;
+            task->bytes.swap(member.data);
+            task->archived = true;
+            push_task(std::move(task));
+        }
+    }
+
+    /* 32x32 grayscale, scene changes are detected on mean abs difference of thumbnails */
+    static void thumbnail(const cv::Mat & frame, cv::Mat & thumb)
+    {
+        const cv::Size THUMB_SIZE(32, 32);
+
+        cv::Mat small;
+        cv::resize(frame, small, THUMB_SIZE, 0, 0, cv::INTER_AREA);
+        cv::cvtColor(small, thumb, cv::COLOR_BGR2GRAY);
+    }
+
+    void enqueue_video(const path & file)
+    {
+        cv::VideoCapture cap(file.string());
+        if (!cap.isOpened())
+        {
+            logger::LOG_MSG(LL::Warning, "Failed to open video: " + file.string());
+            return;
+        }
+
+        const bool reuse = params.video_scene_diff > 0. && params.video_max_reuse > 0;
+
+        // every frame is a task of its own, so <queue_size> bounds the frames in flight
+        std::shared_ptr<key_frame_t> key;
+        size_t num_followers = 0;
+        cv::Mat key_thumb, thumb, diff;
+        for (long index = 0; ; ++index)
+        {
+            // skipped frames are demuxed / decoded but not converted to BGR
+            if (index % (long)params.video_stride != 0)
+            {
+                if (!cap.grab())
+                    break;
+                continue;
+            }
+
+            // a new buffer per frame, frames are owned by tasks
+            cv::Mat frame;
+            if (!cap.read(frame) || frame.empty())
+                break;
+
+            std::unique_ptr<det_task_t> task(new det_task_t);
+            task->file = file;
+            task->frame = index;
+            task->img = frame;
+
+            if (reuse)
+            {
+                thumbnail(frame, thumb);
+                if (key && num_followers < params.video_max_reuse)
+                {
+                    cv::absdiff(thumb, key_thumb, diff);
+                    if (cv::mean(diff)[0] < params.video_scene_diff)
+                    {
+                        task->key = key;
+                        task->follower = true;
+                        ++num_followers;
+                        ++reused_frames;
+                        push_task(std::move(task));
+                        continue;
+                    }
+                }
+                std::swap(key_thumb, thumb);
+
+                key = std::make_shared<key_frame_t>();
+                task->key = key;
+                num_followers = 0;
+            }
+
+            ++key_frames;
+            push_task(std::move(task));
+        }
+    }
+
+    bool decode_file(det_task_t & task)
+    {
+        // video frames are decoded by the reader
+        if (task.frame >= 0)
+        {
+            task.frame_size = task.img.size();
+            return true;
+        }
+
+        if (params.eval)
+            task.has_gt = annotations.load(task.file, task.gt);
+
+        size_t image_size = detector.params.image_size;
+        cv::Size min_size((int)image_size, (int)image_size);
+
+        // archive members are already in memory
+        if (!task.archived)
+        {
+            cmn::stage_timers_t::scope_t t(timers, stage.read);
+            if (!cmn::read_file(task.file.string(), task.bytes))
+            {
+                logger::LOG_MSG(LL::Warning, "Failed to read image: " + task.file.string());
+                reporter.add_failed();
+                return false;
+            }
+        }
+        timers.add_read(task.bytes.size());
+
+        if (cache.is_open())
+        {
+            task.cache_key = cmn::result_cache_t::make_key(cmn::hash64(task.bytes.data(), task.bytes.size()), model_key);
+            task.cache_hit = cache.find(task.cache_key, task.cached) &&
+                task.cached.size() == 2 &&
+                task.cached[0].size == FRAME_PART_SIZE &&
+                task.cached[1].size % detector::detector_t::ROW_SIZE == 0;
+
+            // cascade crops objects from the decoded image
+            bool need_img = params.cascade;
+#           ifdef WITH_OPENCV_HIGHGUI
+                need_img |= params.dbg || params.recheck_falses;
+#           endif // WITH_OPENCV_HIGHGUI
+
+            if (task.cache_hit)
+            {
+                task.frame_size = cv::Size((int)task.cached[0].data[0], (int)task.cached[0].data[1]);
+                task.decode_factor = (int)task.cached[0].data[2];
+
+                // no forward pass, crops are decoded later only if there is one to write
+                if (!need_img)
+                    return true;
+            }
+        }
+
+        {
+            cmn::stage_timers_t::scope_t t(timers, stage.decode);
+            task.img = params.reduced_decode ?
+                cmn::imdecode_reduced(task.bytes, min_size, task.decode_factor) :
+                cv::imdecode(task.bytes, cv::IMREAD_COLOR);
+        }
+        if (task.decode_factor == 1)
+            std::vector<uchar>().swap(task.bytes);
+
+        if (task.img.empty())
+        {
+            logger::LOG_MSG(LL::Warning, "Failed to load image: " + task.file.string());
+            reporter.add_failed();
+            return false;
+        }
+        task.frame_size = task.img.size();
+
+        //if (img.channels() < 3 || (img.type() != CV_8UC3 && img.type() != CV_8UC4))
+        //    return false;
+
+        return true;
+    }
+
+    static bool is_crop(const det_task_t & task, const detector::detector_t::det_res_t & res)
+    {
+        return res.w >= (int)(task.frame_size.width * params.min_width) &&
+            res.h >= (int)(task.frame_size.height * params.min_height);
+    }
+
+    /* the same top-k / NMS selection as the results, at the lowest sweep threshold */
+    static void add_to_sweep(const float * rows, size_t num_rows)
+    {
+        thread_local std::vector<cmn::score_t> keep;
+        detector.select_rows(rows, num_rows, sweep.threshold(), keep);
+        sweep.add(rows, keep, detector::detector_t::ROW_SIZE);
+    }
+
+    static void detect_batch(std::vector<det_task_t *> & batch)
+    {
+        const size_t ROW_SIZE = detector::detector_t::ROW_SIZE;
+
+        std::vector<det_task_t *> misses;
+        for (const auto task : batch)
+        {
+            // results come from the key frame
+            if (task->follower)
+                continue;
+
+            if (!task->cache_hit)
+            {
+                misses.push_back(task);
+                continue;
+            }
+
+            const auto & rows = task->cached[1];
+            {
+                cmn::stage_timers_t::scope_t t(timers, stage.postprocess);
+                detector.process_output(rows.data, rows.size / ROW_SIZE, task->frame_size, task->results);
+            }
+            if (!params.sweep.empty())
+                add_to_sweep(rows.data, rows.size / ROW_SIZE);
+            ++cache_hits;
+        }
+
+        if (misses.empty())
+            return;
+
+        std::vector<cv::Mat> imgs;
+        for (const auto task : misses)
+            imgs.push_back(task->img);
+
+        std::vector<std::vector<float>> rows;
+        detector.forward_batch(imgs, rows);
+
+        for (size_t i = 0; i < misses.size(); ++i)
+        {
+            det_task_t & task = *misses[i];
+            if (cache.is_open() && task.frame < 0)
+            {
+                float frame[FRAME_PART_SIZE] = { (float)task.frame_size.width, (float)task.frame_size.height, (float)task.decode_factor };
+                cache.append(task.cache_key, { { frame, FRAME_PART_SIZE }, { rows[i].data(), rows[i].size() } });
+            }
+            {
+                cmn::stage_timers_t::scope_t t(timers, stage.postprocess);
+                detector.process_output(rows[i].data(), rows[i].size() / ROW_SIZE, task.frame_size, task.results);
+            }
+            if (!params.sweep.empty())
+                add_to_sweep(rows[i].data(), rows[i].size() / ROW_SIZE);
+        }
+    }
+
+    void infer_batch(std::vector<det_task_t *> & batch)
+    {
+        detect_batch(batch);
+
+        if (params.eval)
+            for (const auto task : batch)
+            {
+                if (task->frame >= 0)
+                    continue;
+                if (task->has_gt)
+                    evaluator.add(task->gt, task->results, task->frame_size);
+                else
+                    evaluator.add_missing();
+            }
+
+        if (params.cascade)
+            for (const auto task : batch)
+                if (!task->follower)
+                    classify_objects(*task);
+
+        for (const auto task : batch)
+            if (task->key && !task->follower)
+            {
+                std::lock_guard<std::mutex> lg(task->key->mtx);
+                task->key->results = task->results;
+                task->key->labels = task->labels;
+                task->key->ready = true;
+            }
+
+        // a batch throwing before this point is counted as failed by fail_task(), followers are counted once written
+        size_t num_detected = (size_t)std::count_if(batch.begin(), batch.end(), [](const det_task_t * task) { return !task->follower; });
+        timers.add_images(num_detected);
+        reporter.add_done(num_detected);
+    }
+
+    void classify_objects(det_task_t & task)
+    {
+        const det_vec_t & results = task.results;
+        size_t num_res = std::min(results.size(), params.max_objects);
+        task.labels.assign(num_res, clf::classifier_t::clf_res_t());
+
+        std::vector<path> files;
+        std::vector<cv::Mat> crops;
+        std::vector<size_t> ids;
+        cv::Rect frame(0, 0, task.img.cols, task.img.rows);
+        for (size_t i = 0; i < num_res; ++i)
+        {
+            const auto & res = results[i];
+            cv::Rect roi = cv::Rect(res.x, res.y, res.w, res.h) & frame;
+            if (!is_crop(task, res) || roi.area() == 0)
+                continue;
+
+            // views into the frame, no copies
+            crops.push_back(cv::Mat(task.img, roi));
+            files.push_back(task.file);
+            ids.push_back(i);
+        }
+
+        if (crops.empty())
+            return;
+
+        std::vector<clf::classifier_t::clf_res_t> labels;
+        classifier.process_batch(files, crops, labels);
+        for (size_t i = 0; i < ids.size(); ++i)
+            task.labels[ids[i]] = std::move(labels[i]);
+    }
+
+    /* "<label_1>[_<label_2>]_" from top-1 predictions, the classifier's own filename format */
+    static std::string label_prefix(const clf::classifier_t::clf_res_t & label)
+    {
+        std::string prefix;
+        for (size_t class_id = 0; class_id < classifier.params.num_classes; ++class_id)
+        {
+            if (label.rec[class_id].empty())
+                return std::string();
+            prefix += label.rec[class_id][0].first + '_';
+        }
+
+        return prefix;
+    }
+
+    static void write_cascade_out(const det_task_t & task)
+    {
+        std::stringstream lines;
+        for (size_t i = 0; i < task.labels.size(); ++i)
+        {
+            const auto & res = task.results[i];
+            const auto & label = task.labels[i];
+            if (label.rec[0].empty())
+                continue;
+
+            lines << task.file.string() << ',' << task.frame << ',' << i << ',' << res.x << ',' << res.y << ',' << res.w << ',' << res.h << ',' << res.prob << ',' << res.class_id;
+            for (size_t class_id = 0; class_id < classifier.params.num_classes; ++class_id)
+                for (const auto & pred : label.rec[class_id])
+                    lines << ',' << pred.first << ',' << pred.second;
+            lines << '\n';
+        }
+
+        std::lock_guard<std::mutex> lg(cascade_out_mutex);
+        cascade_out << lines.str();
+    }
+
+    /* encoded on this encode thread, the shard writer only appends */
+    static void write_image(const cv::Mat & img, const path & dst, const path & member)
+    {
+        std::vector<uchar> buf;
+        {
+            cmn::stage_timers_t::scope_t t(timers, stage.encode);
+            if (!cv::imencode(dst.extension().string(), img, buf))
+                return;
+        }
+
+        cmn::stage_timers_t::scope_t t(timers, stage.write);
+        timers.add_written(buf.size());
+        if (shards.is_open())
+            shards.write(member.generic_string(), std::move(buf));
+        else if (!cmn::write_file(dst.string(), buf))
+            logger::LOG_MSG(LL::Warning, "Failed to write image: " + dst.string());
     }
 
-    void move_file(const std::experimental::filesystem::v1::path & file, const cv::Mat & crop, int crop_idx = -1)
+    void move_file(const det_task_t & task, const cv::Mat & crop, int crop_idx = -1, const std::string & prefix = std::string())
     {
+        const path & file = task.file;
+        const long frame = task.frame;
         std::string & filename_short = file.filename().string();
         path dst = params.outdir;
         path subdir = ftr::subdirs(file.parent_path(), params.indir);
@@ -112,25 +855,70 @@ namespace dt
         if (!subdir.empty())
         {
             dst.append(subdir);
-            ftr::create_dir(dst);
+            // shards have no directories
+            if (!shards.is_open())
+                out_dirs.create(dst);
         }
 
-        if (crop_idx != -1)
+        std::string name;
+        if (frame >= 0)
+        {
+            // video frames are written as images, named by frame index
+            std::stringstream ss;
+            ss << prefix << filename_short.substr(0, filename_short.find_last_of('.')) << "_f" << frame;
+            if (crop_idx != -1)
+                ss << '_' << crop_idx;
+            ss << ".jpg";
+            name = ss.str();
+        }
+        else if (crop_idx != -1)
         {
-            std::stringstream name;
-            name << filename_short.substr(0, filename_short.find_last_of('.')) << '_' << crop_idx << file.extension();
-            dst.append(name.str());
+            std::stringstream ss;
+            ss << prefix << filename_short.substr(0, filename_short.find_last_of('.')) << '_' << crop_idx << file.extension().string();
+            name = ss.str();
         }
         else
-            dst.append(filename_short);
+            name = prefix + filename_short;
+        dst.append(name);
 
-        cv::imwrite(dst.string(), crop);
+        write_image(crop, dst, subdir / name);
 
-        if (params.move_out)
+        // a video is never moved, its other frames are still being processed, archives are left intact
+        if (params.move_out && frame < 0 && !task.archived)
             ftr::remove_file(file);
     }
 
-    static void process_file(const path & file, std::mutex & dnn_mutex)
+    /* replaces reduced decode with the full resolution image, detections are rescaled accordingly */
+    static void load_full_image(det_task_t & task)
+    {
+        if (task.decode_factor == 1 && !task.img.empty())
+            return;
+
+        cv::Mat full = task.bytes.empty() ?
+            cv::imread(task.file.string(), cv::IMREAD_COLOR) :
+            cv::imdecode(task.bytes, cv::IMREAD_COLOR);
+        if (full.empty())
+        {
+            logger::LOG_MSG(LL::Warning, "Failed to load image: " + task.file.string());
+            return;
+        }
+
+        // from the normalized boxes, scaling truncated pixels of the reduced image is off by up to the decode factor
+        for (auto & res : task.results)
+        {
+            detector::detector_t::set_pixel_box(res, full.size());
+            res.x = std::min(res.x, full.cols - 1);
+            res.y = std::min(res.y, full.rows - 1);
+            res.w = std::min(res.w, full.cols - res.x);
+            res.h = std::min(res.h, full.rows - res.y);
+        }
+
+        task.img = full;
+        task.frame_size = full.size();
+        task.decode_factor = 1;
+    }
+
+    static void encode_frame(det_task_t & task)
     {
         try
         {
@@ -142,26 +930,27 @@ namespace dt
             const std::string win_lbl("detection");
             const std::string recheck_win_lbl("RECHECK detection");
 
-            cv::Mat img = cv::imread(file.string(), cv::IMREAD_COLOR);
-            if (img.empty())
-            {
-                logger::LOG_MSG(LL::Warning, "Failed to load image: " + file.string());
-                return;
-            }
-
-            //if (img.channels() < 3 || (img.type() != CV_8UC3 && img.type() != CV_8UC4))
-            //    return;
-
-            std::vector<detector::detector_t::det_res_t > results;
-            {
-                std::lock_guard<std::mutex> lg(dnn_mutex);
-                detector.process_file(img, results);
-            }
+            const path & file = task.file;
+            const cv::Mat & img = task.img;
+            const det_vec_t & results = task.results;
 
             size_t num_res = std::min(results.size(), params.max_objects);
             if (num_res == 0)
                 return;
 
+            if (cascade_out.is_open())
+                write_cascade_out(task);
+
+            // reduced decode is upgraded only if there is a crop to write or an image to show
+            bool need_full = false;
+            for (size_t i = 0; !need_full && i < num_res; ++i)
+                need_full = params.outdir_mode >= 0 && is_crop(task, results[i]);
+#           ifdef WITH_OPENCV_HIGHGUI
+                need_full |= params.dbg || params.recheck_falses;
+#           endif // WITH_OPENCV_HIGHGUI
+            if (need_full)
+                load_full_image(task);
+
             int crop_id = 0;
 
 #       ifdef WITH_OPENCV_HIGHGUI
@@ -176,8 +965,8 @@ namespace dt
             {
                 const auto & res = results[i];
                 cv::Rect roi(res.x, res.y, res.w, res.h);
-                bool crop = (res.w >= (int)(img.cols * params.min_width) &&
-                    res.h >= (int)(img.rows * params.min_height));
+                // frame_size, the image is not decoded on a cache hit without crops
+                bool crop = is_crop(task, res);
 
 #           ifdef WITH_OPENCV_HIGHGUI
                 if (params.dbg)
@@ -199,9 +988,12 @@ namespace dt
                 if (params.outdir_mode < 0 || !crop)
                     continue;
 
+                // cascade crops are named after their labels
+                std::string prefix = i < task.labels.size() ? label_prefix(task.labels[i]) : std::string();
+
                 num_res == 1 ?
-                    move_file(file, cv::Mat(img, roi)) :
-                    move_file(file, cv::Mat(img, roi), crop_id++);
+                    move_file(task, cv::Mat(img, roi), -1, prefix) :
+                    move_file(task, cv::Mat(img, roi), crop_id++, prefix);
             }
 
 #       ifdef WITH_OPENCV_HIGHGUI
@@ -218,7 +1010,7 @@ namespace dt
 
                 if (cv::waitKey(0) % 256 == SPACE_KEY)
                 {
-                    move_file(file, img);
+                    move_file(task, img);
                 }
             }
 #       endif // WITH_OPENCV_HIGHGUI
@@ -236,4 +1028,77 @@ namespace dt
             logger::LOG_MSG(LL::Error, "Unknown exception.");
         }
     }
+
+    static void log_failed(const path & file, long frame)
+    {
+        logger::LOG_MSG(LL::Warning, "Failed to process image: " + file.string() + (frame >= 0 ? ", frame " + std::to_string(frame) : std::string()));
+        reporter.add_failed();
+    }
+
+    void fail_task(det_task_t & task)
+    {
+        log_failed(task.file, task.frame);
+        if (!task.key || task.follower)
+            return;
+
+        // followers already parked and still to come have no results to be written with
+        std::vector<std::pair<long, cv::Mat>> pending;
+        {
+            std::lock_guard<std::mutex> lg(task.key->mtx);
+            task.key->failed = true;
+            pending.swap(task.key->pending);
+        }
+        for (const auto & follower : pending)
+            log_failed(task.file, follower.first);
+    }
+
+    void encode_file(det_task_t & task)
+    {
+        if (!task.key)
+        {
+            encode_frame(task);
+            return;
+        }
+
+        // near-identical video frames are written with the detections of their key frame
+        std::vector<std::pair<long, cv::Mat>> pending;
+        {
+            std::lock_guard<std::mutex> lg(task.key->mtx);
+            if (task.follower)
+            {
+                // a follower overtaking its key frame is left to it, encode threads never wait
+                if (task.key->failed)
+                {
+                    log_failed(task.file, task.frame);
+                    return;
+                }
+                if (!task.key->ready)
+                {
+                    task.key->pending.emplace_back(task.frame, task.img);
+                    return;
+                }
+                task.results = task.key->results;
+                task.labels = task.key->labels;
+            }
+            else
+                pending.swap(task.key->pending);
+        }
+
+        encode_frame(task);
+        if (task.follower)
+            reporter.add_done();
+
+        for (auto & follower : pending)
+        {
+            det_task_t frame_task;
+            frame_task.file = task.file;
+            frame_task.frame = follower.first;
+            frame_task.img = follower.second;
+            frame_task.frame_size = follower.second.size();
+            frame_task.results = task.results;
+            frame_task.labels = task.labels;
+            encode_frame(frame_task);
+            reporter.add_done();
+        }
+    }
 }
\ No newline at end of file
@@ -1,8 +1,15 @@
 #pragma once
 
 #include "detection.h"
+#include "crop_sweep.h"
+#include "evaluation.h"
+#include "../CNNClassifierTester/classification.h"
+#include "../common/pipeline.h"
+#include "../common/result_cache.h"
 
 #include <filesystem>
+#include <memory>
+#include <mutex>
 
 #define WITH_OPENCV_HIGHGUI
 
@@ -14,21 +21,112 @@ namespace dt
     {
         path indir;
         int indir_mode;
+        /* binary listing of <indir> read instead of crawling it, built if missing,
+        ** updated with <manifest_refresh>, <manifest_only> stops right after that */
+        path manifest;
+        bool manifest_refresh;
+        bool manifest_only;
         path outdir;
         int outdir_mode;
         bool move_out;
+        bool reduced_decode;
+        /* .tar / .zip files in <indir> are read as image folders, <indir> may be an archive itself */
+        bool archives;
+        /* crops are appended to rolling .tar shards of this size (MB) in <outdir>, 0 - separate files */
+        size_t shard_size;
+        path cache;
+        /* per-stage latency histograms and throughput as .json, disabled if empty */
+        path timing_json;
+        /* progress reporter, disabled if <progress_interval> is 0 */
+        size_t progress_interval;
+        path progress_json;
+        /* crop yield sweep, disabled if empty */
+        path sweep;
+        std::vector<float> sweep_thresh;
+        std::vector<float> sweep_min_size;
+        std::vector<size_t> sweep_max_objects;
         double min_width;
         double min_height;
         size_t max_objects;
+        /* detector -> classifier cascade */
+        bool cascade;
+        path cascade_out;
+        /* evaluation against ground truth sidecars */
+        bool eval;
+        path eval_pr;
+        /* video input: every <video_stride>-th frame is taken, frames differing from the last detected one
+        ** by less than <video_scene_diff> reuse its detections, at most <video_max_reuse> in a row */
+        bool video;
+        size_t video_stride;
+        double video_scene_diff;
+        size_t video_max_reuse;
+        cmn::pipeline_settings_t pipeline;
 #       ifdef WITH_OPENCV_HIGHGUI
         bool dbg;
         bool recheck_falses;
 #       endif // WITH_OPENCV_HIGHGUI
     };
 
+    using det_vec_t = std::vector<detector::detector_t::det_res_t>;
+
+    /* detections of a video key frame, shared with the following near-identical frames */
+    struct key_frame_t
+    {
+        std::mutex mtx;
+        /* set once the key frame has passed inference and cascade classification */
+        bool ready = false;
+        /* the key frame was dropped, its followers are failed too */
+        bool failed = false;
+        det_vec_t results;
+        std::vector<clf::classifier_t::clf_res_t> labels;
+        /* (index, frame) of followers that reached the encode stage before the results, written by the key */
+        std::vector<std::pair<long, cv::Mat>> pending;
+    };
+
+    struct det_task_t
+    {
+        path file;
+        /* video frame index, -1 for still images */
+        long frame = -1;
+        cv::Mat img;
+        int decode_factor = 1;
+        /* size of the decoded image the results refer to, known even if decoding was skipped */
+        cv::Size frame_size;
+        det_vec_t results;
+        /* cascade classification of results[i], empty for objects filtered out */
+        std::vector<clf::classifier_t::clf_res_t> labels;
+        /* ground truth in original image coordinates, loaded only in evaluation mode */
+        std::vector<gt_box_t> gt;
+        bool has_gt = false;
+        /* video frames: results shared by a key frame with its followers, which skip inference */
+        std::shared_ptr<key_frame_t> key;
+        bool follower = false;
+
+        /* encoded file, kept only while a full resolution decode may still be needed */
+        std::vector<uchar> bytes;
+        uint64_t cache_key = 0;
+        bool cache_hit = false;
+        std::vector<cmn::result_cache_t::part_t> cached;
+        /* archive member, <file> is <archive>/<member name> and <bytes> are read by the archive reader */
+        bool archived = false;
+    };
+
     bool init_params(const cv::CommandLineParser & cmd);
     void process_dir();
 
-    /* thread func */
-    static void process_file(const path & file, std::mutex & dnn_mutex);
+    /* ftr::scan callback, feeds the pipeline */
+    void enqueue_file(const path & file, std::mutex & scan_mutex);
+    /* reads frames sequentially, a task per frame that needs a forward pass */
+    void enqueue_video(const path & file);
+    /* streams images out of a .tar / .zip archive, a task per member */
+    void enqueue_archive(const path & archive);
+
+    /* pipeline stages */
+    bool decode_file(det_task_t & task);
+    void infer_batch(std::vector<det_task_t *> & batch);
+    /* single classifier forward pass over all objects of the frame passing min size / max objects filters */
+    void classify_objects(det_task_t & task);
+    void encode_file(det_task_t & task);
+    /* task dropped by an exception in decode or inference */
+    void fail_task(det_task_t & task);
 }
\ No newline at end of file
@@ -0,0 +1,439 @@
+#include "evaluation.h"
+
+#include <logger.h>
+#include <file_utils.h>
+
+#include <algorithm>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+namespace dt
+{
+    using LL = logger::LOG_LEVEL_t;
+
+    namespace
+    {
+        /* text of the first <tag>...</tag> at or after <pos>, <pos> is moved past it */
+        bool xml_value(const std::string & text, const std::string & tag, size_t & pos, std::string & value, size_t end = std::string::npos)
+        {
+            size_t open = text.find('<' + tag + '>', pos);
+            if (open == std::string::npos || open >= end)
+                return false;
+            open += tag.size() + 2;
+
+            size_t close = text.find("</" + tag + '>', open);
+            if (close == std::string::npos || close > end)
+                return false;
+
+            value = text.substr(open, close - open);
+            value.erase(0, value.find_first_not_of(" \t\r\n"));
+            value.erase(value.find_last_not_of(" \t\r\n") + 1);
+            pos = close + tag.size() + 3;
+            return true;
+        }
+
+        bool read_text(const path & filename, std::string & text)
+        {
+            std::ifstream file(filename.string(), std::ios::binary);
+            if (!file.is_open())
+                return false;
+
+            std::stringstream ss;
+            ss << file.rdbuf();
+            text = ss.str();
+            return true;
+        }
+
+        inline float iou(const gt_box_t & a, float x0, float y0, float x1, float y1)
+        {
+            float w = std::min(a.x1, x1) - std::max(a.x0, x0);
+            float h = std::min(a.y1, y1) - std::max(a.y0, y0);
+            if (w <= 0.f || h <= 0.f)
+                return 0.f;
+
+            float inter = w * h;
+            return inter / ((a.x1 - a.x0) * (a.y1 - a.y0) + (x1 - x0) * (y1 - y0) - inter);
+        }
+    }
+
+    bool annotations_t::init(FORMAT format, const path & gt_dir, const path & indir, const path & labels_file)
+    {
+        this->format = format;
+        this->gt_dir = gt_dir;
+        this->indir = indir;
+
+        class_names.clear();
+        if (!labels_file.empty())
+        {
+            std::ifstream file(labels_file.string());
+            if (!file.is_open())
+            {
+                logger::LOG_MSG(LL::Error, "Failed to load " + labels_file.string() + " file.");
+                return false;
+            }
+
+            std::string str;
+            while (std::getline(file, str))
+            {
+                str.erase(str.find_last_not_of(" \t\r") + 1);
+                class_names.push_back(str);
+            }
+        }
+        class_index.build(class_names);
+
+        if (format == VOC && class_names.empty())
+        {
+            logger::LOG_MSG(LL::Error, "VOC annotations require <labels> to map class names to detector class ids.");
+            return false;
+        }
+
+        return true;
+    }
+
+    int annotations_t::class_id(const std::string & name) const
+    {
+        int id = class_index.find(name);
+        if (id >= 0)
+            return id;
+
+        char * end = nullptr;
+        long value = std::strtol(name.c_str(), &end, 10);
+        return (!name.empty() && *end == '\0') ? (int)value : -1;
+    }
+
+    bool annotations_t::load(const path & image, std::vector<gt_box_t> & boxes) const
+    {
+        boxes.clear();
+
+        path sidecar = image.parent_path();
+        if (!gt_dir.empty())
+        {
+            sidecar = gt_dir;
+            sidecar /= ftr::subdirs(image.parent_path(), indir);
+        }
+        sidecar /= image.stem().string() + (format == VOC ? ".xml" : ".csv");
+
+        std::string text;
+        if (!read_text(sidecar, text))
+            return false;
+
+        return format == VOC ? load_voc(text, boxes) : load_csv(text, boxes);
+    }
+
+    bool annotations_t::load_voc(const std::string & text, std::vector<gt_box_t> & boxes) const
+    {
+        size_t pos = 0;
+        std::string object;
+        while (xml_value(text, "object", pos, object))
+        {
+            size_t p = 0;
+            std::string name, value;
+            if (!xml_value(object, "name", p, name))
+                return false;
+
+            gt_box_t box;
+            box.class_id = class_id(name);
+            if (box.class_id < 0)
+            {
+                logger::LOG_MSG(LL::Warning, "Unknown class in annotation: " + name);
+                continue;
+            }
+
+            p = 0;
+            box.difficult = xml_value(object, "difficult", p, value) && value == "1";
+
+            float * coords[] = { &box.x0, &box.y0, &box.x1, &box.y1 };
+            const char * tags[] = { "xmin", "ymin", "xmax", "ymax" };
+            for (int i = 0; i < 4; ++i)
+            {
+                p = 0;
+                if (!xml_value(object, tags[i], p, value))
+                    return false;
+                *coords[i] = std::stof(value);
+            }
+
+            boxes.push_back(box);
+        }
+
+        return true;
+    }
+
+    bool annotations_t::load_csv(const std::string & text, std::vector<gt_box_t> & boxes) const
+    {
+        std::stringstream lines(text);
+        std::string line;
+        while (std::getline(lines, line))
+        {
+            if (line.empty() || line[0] == '#' || line == "\r")
+                continue;
+
+            std::stringstream ss(line);
+            std::string name;
+            std::getline(ss, name, ',');
+
+            gt_box_t box;
+            box.class_id = class_id(name);
+            // header or unknown class
+            if (box.class_id < 0)
+                continue;
+
+            char sep;
+            int difficult = 0;
+            if (!(ss >> box.x0 >> sep >> box.y0 >> sep >> box.x1 >> sep >> box.y1))
+                return false;
+            if (ss >> sep >> difficult)
+                box.difficult = difficult != 0;
+
+            boxes.push_back(box);
+        }
+
+        return true;
+    }
+
+    void evaluator_t::init(const std::vector<float> & iou_thresholds, const std::vector<std::string> & class_names)
+    {
+        this->iou_thresholds = iou_thresholds;
+        names = class_names;
+    }
+
+    evaluator_t::shard_t & evaluator_t::local_shard()
+    {
+        struct cached_t
+        {
+            const evaluator_t * owner;
+            shard_t * shard;
+        };
+        thread_local std::vector<cached_t> cached;
+
+        for (auto & c : cached)
+            if (c.owner == this)
+                return *c.shard;
+
+        std::lock_guard<std::mutex> lg(shards_mutex);
+        shards.emplace_back(new shard_t);
+        cached.push_back(cached_t{ this, shards.back().get() });
+        return *shards.back();
+    }
+
+    evaluator_t::class_stat_t & evaluator_t::class_stat(shard_t & shard, int class_id) const
+    {
+        if ((size_t)class_id >= shard.classes.size())
+            shard.classes.resize(class_id + 1);
+
+        class_stat_t & stat = shard.classes[class_id];
+        stat.dets.resize(iou_thresholds.size());
+        return stat;
+    }
+
+    void evaluator_t::add(const std::vector<gt_box_t> & gt, const std::vector<detector::detector_t::det_res_t> & dets, const cv::Size & img_size)
+    {
+        shard_t & shard = local_shard();
+        ++shard.images;
+
+        for (const auto & box : gt)
+            if (!box.difficult)
+                ++class_stat(shard, box.class_id).num_gt;
+
+        // sorted-sweep index: boxes by class, then by x0, only boxes starting left of the detection's right edge are visited
+        thread_local std::vector<gt_box_t> sorted;
+        sorted.assign(gt.begin(), gt.end());
+        std::sort(sorted.begin(), sorted.end(), [](const gt_box_t & l, const gt_box_t & r) { return l.class_id < r.class_id || (l.class_id == r.class_id && l.x0 < r.x0); });
+
+        thread_local std::vector<char> matched;
+        for (size_t t = 0; t < iou_thresholds.size(); ++t)
+        {
+            matched.assign(sorted.size(), 0);
+
+            for (const auto & det : dets)
+            {
+                float x0 = det.box[0] * img_size.width;
+                float y0 = det.box[1] * img_size.height;
+                float x1 = det.box[2] * img_size.width;
+                float y1 = det.box[3] * img_size.height;
+
+                auto first = std::lower_bound(sorted.begin(), sorted.end(), det.class_id, [](const gt_box_t & b, int c) { return b.class_id < c; });
+                auto last = std::upper_bound(first, sorted.end(), det.class_id, [](int c, const gt_box_t & b) { return c < b.class_id; });
+                last = std::upper_bound(first, last, x1, [](float x, const gt_box_t & b) { return x <= b.x0; });
+
+                // VOC rule: the best overlapping box decides, even if it is already matched
+                float best_iou = 0.f;
+                size_t best = sorted.size();
+                for (auto it = first; it != last; ++it)
+                {
+                    if (it->x1 <= x0)
+                        continue;
+
+                    float overlap = iou(*it, x0, y0, x1, y1);
+                    if (overlap > best_iou)
+                    {
+                        best_iou = overlap;
+                        best = it - sorted.begin();
+                    }
+                }
+
+                bool tp = false;
+                if (best < sorted.size() && best_iou >= iou_thresholds[t])
+                {
+                    if (sorted[best].difficult)
+                        continue;
+
+                    tp = !matched[best];
+                    matched[best] = 1;
+                }
+
+                class_stat(shard, det.class_id).dets[t].push_back(det_t{ det.prob, tp });
+            }
+        }
+    }
+
+    void evaluator_t::merge(result_t & result) const
+    {
+        const size_t NUM_RECALL_POINTS = 101;
+
+        std::lock_guard<std::mutex> lg(shards_mutex);
+
+        size_t num_classes = 0;
+        for (const auto & shard : shards)
+        {
+            result.images += shard->images;
+            num_classes = std::max(num_classes, shard->classes.size());
+        }
+
+        result.num_gt.assign(num_classes, 0);
+        result.ap.assign(iou_thresholds.size(), std::vector<double>(num_classes, 0.));
+        result.pr.assign(iou_thresholds.size(), std::vector<std::vector<double>>(num_classes));
+
+        std::vector<det_t> dets;
+        std::vector<double> recall, precision;
+        for (size_t c = 0; c < num_classes; ++c)
+        {
+            for (const auto & shard : shards)
+                if (c < shard->classes.size())
+                    result.num_gt[c] += shard->classes[c].num_gt;
+
+            for (size_t t = 0; t < iou_thresholds.size(); ++t)
+            {
+                dets.clear();
+                for (const auto & shard : shards)
+                    if (c < shard->classes.size() && t < shard->classes[c].dets.size())
+                        dets.insert(dets.end(), shard->classes[c].dets[t].begin(), shard->classes[c].dets[t].end());
+                std::sort(dets.begin(), dets.end(), [](const det_t & l, const det_t & r) { return l.score > r.score; });
+
+                size_t num_gt = result.num_gt[c];
+                recall.clear();
+                precision.clear();
+                size_t tp = 0;
+                for (size_t i = 0; i < dets.size(); ++i)
+                {
+                    tp += dets[i].tp ? 1 : 0;
+                    recall.push_back(num_gt ? 1. * tp / num_gt : 0.);
+                    precision.push_back(1. * tp / (i + 1));
+                }
+
+                // precision envelope, monotonically decreasing with recall
+                for (size_t i = precision.size(); i-- > 1;)
+                    precision[i - 1] = std::max(precision[i - 1], precision[i]);
+
+                double ap = 0.;
+                double prev_recall = 0.;
+                for (size_t i = 0; i < recall.size(); ++i)
+                {
+                    ap += (recall[i] - prev_recall) * precision[i];
+                    prev_recall = recall[i];
+                }
+                result.ap[t][c] = ap;
+
+                std::vector<double> & pr = result.pr[t][c];
+                pr.assign(NUM_RECALL_POINTS, 0.);
+                size_t i = 0;
+                for (size_t r = 0; r < NUM_RECALL_POINTS; ++r)
+                {
+                    double level = 1. * r / (NUM_RECALL_POINTS - 1);
+                    while (i < recall.size() && recall[i] < level)
+                        ++i;
+                    pr[r] = i < recall.size() ? precision[i] : 0.;
+                }
+            }
+        }
+    }
+
+    std::string evaluator_t::class_name(size_t class_id) const
+    {
+        return class_id < names.size() && !names[class_id].empty() ? names[class_id] : std::to_string(class_id);
+    }
+
+    void evaluator_t::report() const
+    {
+        result_t result;
+        merge(result);
+
+        std::stringstream msg;
+        msg << "\nDetector evaluation: " << result.images << " images";
+        if (missing)
+            msg << ", " << missing << " skipped without annotation";
+        msg << '\n';
+
+        msg << std::setw(15) << "class" << std::setw(8) << "gt";
+        for (float t : iou_thresholds)
+            msg << "   AP@" << std::fixed << std::setprecision(2) << t;
+        msg << '\n';
+
+        std::vector<double> map(iou_thresholds.size(), 0.);
+        size_t num_classes = 0;
+        for (size_t c = 0; c < result.num_gt.size(); ++c)
+        {
+            if (!result.num_gt[c])
+                continue;
+
+            ++num_classes;
+            msg << std::setw(15) << class_name(c) << std::setw(8) << result.num_gt[c];
+            for (size_t t = 0; t < iou_thresholds.size(); ++t)
+            {
+                msg << std::setw(10) << std::setprecision(4) << result.ap[t][c];
+                map[t] += result.ap[t][c];
+            }
+            msg << '\n';
+        }
+
+        double map_avg = 0.;
+        msg << std::setw(15) << "mAP" << std::setw(8) << ' ';
+        for (size_t t = 0; t < iou_thresholds.size(); ++t)
+        {
+            map[t] = num_classes ? map[t] / num_classes : 0.;
+            map_avg += map[t];
+            msg << std::setw(10) << std::setprecision(4) << map[t];
+        }
+        if (iou_thresholds.size() > 1)
+            msg << "\nmAP averaged over IoU thresholds: " << std::setprecision(4) << map_avg / iou_thresholds.size();
+
+        logger::LOG_MSG(LL::Info, msg.str());
+    }
+
+    bool evaluator_t::save_pr(const path & filename) const
+    {
+        std::ofstream out(filename.string());
+        if (!out.is_open())
+        {
+            logger::LOG_MSG(LL::Error, "Failed to open " + filename.string());
+            return false;
+        }
+
+        result_t result;
+        merge(result);
+
+        out << "class,iou,recall,precision\n";
+        for (size_t t = 0; t < iou_thresholds.size(); ++t)
+            for (size_t c = 0; c < result.num_gt.size(); ++c)
+            {
+                if (!result.num_gt[c])
+                    continue;
+
+                const auto & pr = result.pr[t][c];
+                for (size_t r = 0; r < pr.size(); ++r)
+                    out << class_name(c) << ',' << iou_thresholds[t] << ',' << 1. * r / (pr.size() - 1) << ',' << pr[r] << '\n';
+            }
+
+        return true;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,113 @@
+#pragma once
+
+#include "detection.h"
+#include "../common/label_index.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace dt
+{
+    using path = detector::path;
+
+    struct gt_box_t
+    {
+        int class_id;
+        float x0, y0, x1, y1;
+        bool difficult = false;
+    };
+
+    /* ground truth sidecar annotations
+    ** voc: <object><name/><difficult/><bndbox><xmin/><ymin/><xmax/><ymax/></bndbox></object>, names resolved with <labels>
+    ** csv: one box per line "class,x_min,y_min,x_max,y_max[,difficult]", class is an id or a name from <labels> */
+    class annotations_t
+    {
+    public:
+        enum FORMAT
+        {
+            VOC,
+            CSV
+        };
+
+        bool init(FORMAT format, const path & gt_dir, const path & indir, const path & labels_file);
+
+        /* sidecar of <image>: <gt_dir>/<subdirs>/<stem>.{xml|csv}, or next to the image if <gt_dir> is empty
+        ** false if there is no sidecar or it can't be parsed */
+        bool load(const path & image, std::vector<gt_box_t> & boxes) const;
+
+        const std::vector<std::string> & labels() const { return class_names; }
+
+    private:
+        int class_id(const std::string & name) const;
+        bool load_voc(const std::string & text, std::vector<gt_box_t> & boxes) const;
+        bool load_csv(const std::string & text, std::vector<gt_box_t> & boxes) const;
+
+        FORMAT format = VOC;
+        path gt_dir;
+        path indir;
+        std::vector<std::string> class_names;
+        cmn::label_index_t class_index;
+    };
+
+    /* VOC-style detector evaluation: greedy matching by score at every IoU threshold,
+    ** all-point interpolated AP per class, mAP and PR curves
+    ** add() accumulates into a per-thread shard without locks, shards are merged by report() / save_pr() */
+    class evaluator_t
+    {
+    public:
+        void init(const std::vector<float> & iou_thresholds, const std::vector<std::string> & class_names);
+
+        /* <dets> are sorted by prob, matched by their normalized boxes mapped to <img_size>, the size ground truth refers to */
+        void add(const std::vector<gt_box_t> & gt, const std::vector<detector::detector_t::det_res_t> & dets, const cv::Size & img_size);
+        void add_missing() { ++missing; }
+
+        void report() const;
+        /* class, iou, recall, precision at 101 recall points */
+        bool save_pr(const path & filename) const;
+
+    private:
+        struct det_t
+        {
+            float score;
+            bool tp;
+        };
+
+        struct class_stat_t
+        {
+            size_t num_gt = 0;
+            /* per IoU threshold */
+            std::vector<std::vector<det_t>> dets;
+        };
+
+        struct shard_t
+        {
+            size_t images = 0;
+            std::vector<class_stat_t> classes;
+        };
+
+        struct result_t
+        {
+            size_t images = 0;
+            std::vector<size_t> num_gt;
+            /* [iou][class] */
+            std::vector<std::vector<double>> ap;
+            /* [iou][class], precision at 101 recall points */
+            std::vector<std::vector<std::vector<double>>> pr;
+        };
+
+        shard_t & local_shard();
+        class_stat_t & class_stat(shard_t & shard, int class_id) const;
+        void merge(result_t & result) const;
+        std::string class_name(size_t class_id) const;
+
+        std::vector<float> iou_thresholds;
+        std::vector<std::string> names;
+
+        std::atomic<size_t> missing{ 0 };
+        mutable std::mutex shards_mutex;
+        std::vector<std::unique_ptr<shard_t>> shards;
+    };
+}
\ No newline at end of file
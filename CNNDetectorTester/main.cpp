@@ -11,16 +11,79 @@ int main(int argc, char ** argv)
         "{weights w||path to .bin file with model weights}"
         "{image_size |300|classifier's input image size, 3 channels rgb image assumed}"
         "{threshold|0.5|detector threshold}"
+        "{nms|0|IoU threshold of class-aware NMS over detector output (0 - disabled, for models with their own NMS layer)}"
+        "{soft_nms|0|gaussian soft-NMS instead of suppression, scores of boxes overlapping above <nms> are decayed}"
+        "{soft_nms_sigma|0.5|soft-NMS gaussian sigma}"
+        "{top_k|200|max detections per image or tile kept before NMS (0 - unlimited)}"
+        "{tile_size|0|frames larger than it (px) are also run as overlapping tiles of this size in the same batch (0 - disabled)}"
+        "{tile_stride|0|distance between tiles (px, 0 - 3/4 of <tile_size>)}"
+        "{tile_full|1|run the whole frame besides its tiles, for objects larger than a tile}"
+        "{tile_skip_std|2|skip tiles with pixel stddev below it, e.g. sky or road surface (0 - disabled)}"
+        "{tile_merge|0.6|boxes cut by a tile border covered by a box of the same class from another tile more than this part of the smaller box are merged}"
+        "{replicas|4|number of independent network replicas used for parallel inference}"
+        "{profile_layers|0|report per-layer forward times (mean / percentiles / share), FLOPs and memory of the network}"
+        "{profile_warmup|16|number of network inputs per replica passed before <profile_layers> starts collecting}"
+
+        /* cascade classifier params, see CNNClassifierTester */
+        "{clf_model||path to .xml file with cascade classifier architecture}"
+        "{clf_weights||path to .bin file with cascade classifier weights}"
+        "{clf_filename_as_labels|0|unused, crops have no ground truth}"
+        "{clf_image_size|72|cascade classifier's input image size}"
+        "{clf_classifier_mode|1|1 - single-class classification, 2 - two-classes classification}"
+        "{clf_replicas|4|number of cascade classifier replicas}"
+        "{clf_classifier_threshold_0|0.3|first cascade classifier threshold}"
+        "{clf_classes_0|first.txt|path to .txt file with listed classes for first cascade classifier}"
+        "{clf_topk_0|1|topk predictions for first cascade classifier}"
+        "{clf_classifier_threshold_1|0.3|second cascade classifier threshold}"
+        "{clf_classes_1|second.txt|path to .txt file with listed classes for second cascade classifier}"
+        "{clf_topk_1|1|topk predictions for second cascade classifier}"
+        "{clf_profile_layers|0|<profile_layers> for the cascade classifier}"
+        "{clf_profile_warmup|16|<profile_warmup> for the cascade classifier}"
+        "{clf_sweep||path to output .csv with cascade classifier coverage over a grid of thresholds and k (empty - disabled)}"
+        "{clf_sweep_step|0.05|threshold step for <clf_sweep>}"
+        "{clf_sweep_topk|5|max k for <clf_sweep>}"
 
         /* cropper params */
         "{indir||path to dir with test images}"
         "{indir_mode|-1|0 - root folder only, n - allowed subdirs depth (-1 for any depth)}"
+        "{manifest||path to binary listing of <indir>, built on the first run and read instead of crawling <indir> (empty - disabled)}"
+        "{manifest_refresh|0|update <manifest> first, only directories whose mtime changed are listed again}"
+        "{manifest_only|0|only build / refresh <manifest>, no model is loaded}"
         "{outdir||path to output dir with cropped images}"
         "{outdir_mode|0|-1 - disable output, 0 - common root folder, 1 - separate folders}"
         "{move_out|0|move images to output directory (copy by default)}"
+        "{cache||path to inference result cache file, reused across runs with the same images, model and preprocessing (empty - disabled)}"
+        "{shard_size|0|append output images to rolling .tar shards of this size (MB) with a .index.csv instead of separate files (0 - disabled, not with move_out)}"
+        "{archives|0|read images from .tar and .zip (stored) files in <indir> without extraction, <indir> may be an archive itself}"
+        "{reduced_decode|0|decode JPEGs at 1/2, 1/4 or 1/8 scale still covering <image_size>, full resolution only for crops / shown images}"
+        "{video|0|also read .mp4, .avi, .mkv and .mov files from <indir>, crops are named <video>_f<frame index>}"
+        "{video_stride|1|take every n-th video frame}"
+        "{video_scene_diff|0|frames whose 32x32 grayscale thumbnail differs from the last detected frame by less than it (mean abs, 0..255) reuse its detections (0 - disabled)}"
+        "{video_max_reuse|25|max consecutive frames reusing detections of a single frame}"
         "{min_width|0.5|min object width relative to image width}"
         "{min_height|0.5|min object height relative to image width}"
         "{max_objects|1|max num of objects on single image}"
+        "{cascade|0|classify objects passing <min_width>, <min_height> and <max_objects> with <clf_model> in-process, crops are named after their labels}"
+        "{cascade_out||path to output .csv with cascade results (empty - disabled)}"
+        "{sweep||path to output .csv with number of crops over a grid of <sweep_thresh> x <sweep_min_size> x <sweep_max_objects> (empty - disabled)}"
+        "{sweep_thresh|0.3,0.4,0.5,0.6,0.7,0.8,0.9|comma separated detector thresholds for <sweep>}"
+        "{sweep_min_size|0,0.1,0.25,0.5,0.75|comma separated min object width and height relative to image size for <sweep>}"
+        "{sweep_max_objects|1,2,5,10|comma separated max num of objects on single image for <sweep>}"
+        "{eval|0|evaluate detections against ground truth sidecar annotations, per-class AP and mAP (use a low <threshold>)}"
+        "{gt_format|voc|ground truth format: voc - Pascal VOC .xml, csv - class,x_min,y_min,x_max,y_max[,difficult] per line}"
+        "{gt_dir||root of ground truth files mirroring <indir> subdirs (empty - next to images)}"
+        "{labels||path to file with class names, one per line, line number is the detector class id}"
+        "{eval_iou|0.5,0.75|comma separated IoU thresholds for <eval>}"
+        "{eval_pr||path to output .csv with PR curves for <eval> (empty - disabled)}"
+        "{timing_json||path to output .json with per-stage latency histograms, images/sec and bytes read / written (empty - disabled)}"
+        "{progress_interval|30|seconds between lines with images done / failed, images/sec, queue depths and ETA (0 - disabled)}"
+        "{progress_json||path to a .json rewritten with every progress line (empty - disabled)}"
+        "{decode_threads|8|number of image decoding threads}"
+        "{infer_threads|0|number of inference threads (0 - one per network replica)}"
+        "{encode_threads|4|number of cropping / writing threads}"
+        "{queue_size|64|max number of images queued between pipeline stages}"
+        "{batch_size|8|max number of images in a single forward pass}"
+        "{batch_wait|10|max time (ms) to wait for a batch to fill before running forward}"
 #       ifdef WITH_OPENCV_HIGHGUI
             "{debug_win dbg|0|output window with detection results}"
             "{recheck_falses recheck|0|manual recheck of objects of lower size and images without detected images}"
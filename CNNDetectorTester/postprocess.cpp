@@ -0,0 +1,185 @@
+#include "postprocess.h"
+
+#include <opencv2/core/hal/intrin.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace detector
+{
+    namespace
+    {
+        const size_t SCORE = 2;
+        const size_t CLASS = 1;
+        const size_t BOX = 3;
+
+        auto score_desc = [](const cmn::score_t & l, const cmn::score_t & r) { return l.second > r.second || (l.second == r.second && l.first < r.first); };
+
+        inline float iou(const float * a, const float * b)
+        {
+            float w = std::min(a[2], b[2]) - std::max(a[0], b[0]);
+            float h = std::min(a[3], b[3]) - std::max(a[1], b[1]);
+            if (w <= 0.f || h <= 0.f)
+                return 0.f;
+
+            float inter = w * h;
+            float area_a = (a[2] - a[0]) * (a[3] - a[1]);
+            float area_b = (b[2] - b[0]) * (b[3] - b[1]);
+            return inter / (area_a + area_b - inter);
+        }
+
+        /* intersection over the smaller box, a box cut at a tile border lies almost entirely inside the whole one */
+        inline float ios(const float * a, const float * b)
+        {
+            float w = std::min(a[2], b[2]) - std::max(a[0], b[0]);
+            float h = std::min(a[3], b[3]) - std::max(a[1], b[1]);
+            if (w <= 0.f || h <= 0.f)
+                return 0.f;
+
+            float area_a = (a[2] - a[0]) * (a[3] - a[1]);
+            float area_b = (b[2] - b[0]) * (b[3] - b[1]);
+            return w * h / std::max(std::min(area_a, area_b), 1e-12f);
+        }
+
+        void filter_scores(const float * rows, size_t num_rows, size_t row_size, float thresh, std::vector<cmn::score_t> & cand)
+        {
+            // strided scores are packed first, so the comparison runs on full vectors
+            thread_local std::vector<float> scores;
+            scores.resize(num_rows);
+            for (size_t i = 0; i < num_rows; ++i)
+                scores[i] = rows[i * row_size + SCORE];
+
+            cand.clear();
+            size_t i = 0;
+#if CV_SIMD128
+            const cv::v_float32x4 v_thresh = cv::v_setall_f32(thresh);
+            for (; i + 4 <= num_rows; i += 4)
+            {
+                int mask = cv::v_signmask(cv::v_load(scores.data() + i) > v_thresh);
+                for (size_t j = 0; mask; ++j, mask >>= 1)
+                    if (mask & 1)
+                        cand.push_back(std::make_pair(i + j, scores[i + j]));
+            }
+#endif // CV_SIMD128
+            for (; i < num_rows; ++i)
+                if (scores[i] > thresh)
+                    cand.push_back(std::make_pair(i, scores[i]));
+        }
+
+        void hard_nms(const float * rows, size_t row_size, float max_iou, const std::vector<cmn::score_t> & cand, std::vector<cmn::score_t> & keep)
+        {
+            for (const auto & c : cand)
+            {
+                const float * row = rows + c.first * row_size;
+
+                bool suppressed = false;
+                for (size_t k = 0; !suppressed && k < keep.size(); ++k)
+                {
+                    const float * kept = rows + keep[k].first * row_size;
+                    suppressed = kept[CLASS] == row[CLASS] && iou(kept + BOX, row + BOX) > max_iou;
+                }
+
+                if (!suppressed)
+                    keep.push_back(c);
+            }
+        }
+
+        void soft_nms(const float * rows, size_t row_size, float thresh, const nms_param_t & nms, std::vector<cmn::score_t> & cand, std::vector<cmn::score_t> & keep)
+        {
+            while (!cand.empty())
+            {
+                auto best = std::min_element(cand.begin(), cand.end(), score_desc);
+                cmn::score_t top = *best;
+                *best = cand.back();
+                cand.pop_back();
+                keep.push_back(top);
+
+                const float * top_row = rows + top.first * row_size;
+                for (size_t k = 0; k < cand.size();)
+                {
+                    const float * row = rows + cand[k].first * row_size;
+                    if (row[CLASS] == top_row[CLASS])
+                    {
+                        float overlap = iou(top_row + BOX, row + BOX);
+                        if (overlap > nms.iou)
+                            cand[k].second *= std::exp(-overlap * overlap / nms.sigma);
+                    }
+
+                    if (cand[k].second <= thresh)
+                    {
+                        cand[k] = cand.back();
+                        cand.pop_back();
+                    }
+                    else
+                        ++k;
+                }
+            }
+        }
+
+        inline float area(const float * box)
+        {
+            return (box[2] - box[0]) * (box[3] - box[1]);
+        }
+
+        /* only the smaller box of a pair may be a part cut by a tile border,
+        ** distinct small objects inside a larger box are never cut and are kept */
+        void merge_tiles(const float * rows, size_t row_size, float min_ios, std::vector<cmn::score_t> & keep)
+        {
+            size_t num_kept = 0;
+            for (size_t i = 0; i < keep.size(); ++i)
+            {
+                const float * row = rows + keep[i].first * row_size;
+
+                bool duplicate = false;
+                for (size_t k = 0; !duplicate && k < num_kept; ++k)
+                {
+                    const float * kept = rows + keep[k].first * row_size;
+                    const float * smaller = area(kept + BOX) < area(row + BOX) ? kept : row;
+                    duplicate = is_cut(smaller) && input_id(kept) != input_id(row) && kept[CLASS] == row[CLASS] && ios(kept + BOX, row + BOX) > min_ios;
+                }
+
+                if (!duplicate)
+                    keep[num_kept++] = keep[i];
+            }
+            keep.resize(num_kept);
+        }
+    }
+
+    void select_detections(const float * rows, size_t num_rows, size_t row_size, float thresh, const nms_param_t & nms, std::vector<cmn::score_t> & keep)
+    {
+        thread_local std::vector<cmn::score_t> cand;
+        filter_scores(rows, num_rows, row_size, thresh, cand);
+
+        std::sort(cand.begin(), cand.end(), score_desc);
+
+        // per input, tiles of a frame do not compete for the same top-k
+        if (nms.top_k && cand.size() > nms.top_k)
+        {
+            thread_local std::vector<size_t> per_input;
+            per_input.clear();
+
+            size_t num_cand = 0;
+            for (const auto & c : cand)
+            {
+                size_t id = (size_t)std::max(input_id(rows + c.first * row_size), 0);
+                if (id >= per_input.size())
+                    per_input.resize(id + 1, 0u);
+                if (per_input[id]++ < nms.top_k)
+                    cand[num_cand++] = c;
+            }
+            cand.resize(num_cand);
+        }
+
+        keep.clear();
+        if (nms.iou <= 0.f)
+            keep.swap(cand);
+        else if (!nms.soft)
+            hard_nms(rows, row_size, nms.iou, cand, keep);
+        else
+            soft_nms(rows, row_size, thresh, nms, cand, keep);
+
+        if (nms.tile_merge > 0.f)
+            merge_tiles(rows, row_size, nms.tile_merge, keep);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,33 @@
+#pragma once
+
+#include "../common/topk.h"
+
+#include <vector>
+
+namespace detector
+{
+    struct nms_param_t
+    {
+        /* IoU above which a lower scored box of the same class is suppressed, 0 - NMS disabled */
+        float iou = 0.f;
+        /* gaussian soft-NMS: scores of boxes overlapping above <iou> are decayed by exp(-IoU^2 / sigma) instead of dropped */
+        bool soft = false;
+        float sigma = 0.5f;
+        /* max boxes of every network input (row[0], the frame or a tile) kept before NMS, 0 - unlimited */
+        size_t top_k = 0;
+        /* tiled inference: a box cut by a tile border, of the same class as a box from another input,
+        ** covered by it by more than this part of the smaller of the two is a duplicate and is dropped, 0 - disabled */
+        float tile_merge = 0.f;
+    };
+
+    /* image_id of a row: the network input, stored as -1 - id for a box cut by a tile border inside the frame */
+    inline float encode_input_id(int input_id, bool cut) { return cut ? -1.f - input_id : (float)input_id; }
+    inline int input_id(const float * row) { return row[0] < 0.f ? (int)(-1.f - row[0]) : (int)row[0]; }
+    inline bool is_cut(const float * row) { return row[0] < 0.f; }
+
+    /* raw SSD-style rows [image_id, class_id, score, x_min, y_min, x_max, y_max], normalized coordinates
+    ** <keep> = (row index, score) of rows with score > <thresh> after the per-input top-k pre-cut and class-aware NMS,
+    ** sorted by score descending, scores are decayed ones for soft-NMS
+    ** cross-tile duplicates are merged last */
+    void select_detections(const float * rows, size_t num_rows, size_t row_size, float thresh, const nms_param_t & nms, std::vector<cmn::score_t> & keep);
+}
\ No newline at end of file
@@ -0,0 +1,793 @@
+#include "../CNNClassifierTester/classification.h"
+#include "../CNNDetectorTester/detection.h"
+#include "../common/image_io.h"
+#include "../common/pipeline.h"
+#include "../common/preprocess.h"
+#include "../common/stage_timers.h"
+
+#include <opencv2/dnn.hpp>
+#include <opencv2/imgcodecs.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+
+/* throughput and latency of the classifier and detector, end to end and per stage (decode, preprocess, inference, stats),
+** on a deterministic synthetic dataset: JPEGs named <class_1>[_<class_2>]_<idx>.jpg, generated under <data>
+** on the first run and reused while its parameters match
+** both networks are tiny ones assembled in code with seeded weights, so no model files are needed
+** and the numbers of two runs with the same options are comparable */
+
+namespace
+{
+    namespace fs = std::experimental::filesystem::v1;
+    using path = fs::path;
+    using bench_clock_t = cmn::stage_timers_t::timer_clock_t;
+    using clf_t = clf::classifier_t;
+
+    struct dataset_t
+    {
+        size_t count;
+        cv::Size size;
+        int quality;
+        size_t classes;
+        size_t heads;
+        uint64 seed;
+
+        path root;
+        std::vector<std::string> files;
+        std::vector<path> class_files;
+    };
+
+    std::string class_name(char prefix, size_t idx, size_t classes)
+    {
+        std::string num = std::to_string(idx);
+        std::string width = std::to_string(classes - 1);
+        return prefix + std::string(width.size() - std::min(width.size(), num.size()), '0') + num;
+    }
+
+    /* background gradient and shapes coloured by the labels, plus noise so JPEG sizes are close to real photos */
+    cv::Mat synth_image(const dataset_t & ds, size_t idx, const std::vector<size_t> & labels)
+    {
+        cv::RNG rng(ds.seed * 1000003u + idx);
+        cv::Mat img(ds.size, CV_8UC3);
+
+        cv::Scalar from(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256));
+        cv::Scalar to(rng.uniform(0, 256), rng.uniform(0, 256), rng.uniform(0, 256));
+        for (int x = 0; x < img.cols; ++x)
+            img.col(x).setTo(from + (to - from) * (1. * x / img.cols));
+
+        for (int k = 0; k < 8; ++k)
+        {
+            size_t label = labels[k % labels.size()];
+            cv::Scalar color(37. * label, 255. - 53. * (label % 5), 91. * (label % 3));
+            cv::Point center(rng.uniform(0, img.cols), rng.uniform(0, img.rows));
+            int radius = rng.uniform(img.rows / 16 + 1, img.rows / 4 + 2);
+
+            if (k % 2)
+                cv::circle(img, center, radius, color, cv::FILLED);
+            else
+                cv::rectangle(img, cv::Rect(center.x - radius, center.y - radius / 2, 2 * radius, radius), color, cv::FILLED);
+        }
+
+        cv::Mat noise(ds.size, CV_16SC3);
+        rng.fill(noise, cv::RNG::NORMAL, cv::Scalar::all(0), cv::Scalar::all(6));
+        cv::add(img, noise, img, cv::noArray(), CV_8U);
+
+        return img;
+    }
+
+    /* file names and class lists are a function of the parameters, images are written only if <root>/dataset.txt differs */
+    bool make_dataset(dataset_t & ds)
+    {
+        std::stringstream stamp;
+        stamp << "count " << ds.count << " size " << ds.size.width << 'x' << ds.size.height << " quality " << ds.quality
+            << " classes " << ds.classes << " heads " << ds.heads << " seed " << ds.seed;
+
+        std::error_code ec;
+        fs::create_directories(ds.root, ec);
+
+        std::string old_stamp;
+        {
+            std::ifstream in(ds.root / "dataset.txt");
+            std::getline(in, old_stamp);
+        }
+        bool generate = old_stamp != stamp.str();
+
+        ds.class_files.clear();
+        for (size_t h = 0; h < ds.heads; ++h)
+        {
+            ds.class_files.push_back(ds.root / ("head" + std::to_string(h) + ".txt"));
+            std::ofstream out(ds.class_files.back());
+            for (size_t c = 0; c < ds.classes; ++c)
+                out << class_name((char)('a' + h), c, ds.classes) << '\n';
+            if (!out)
+                return false;
+        }
+
+        if (generate)
+        {
+            fs::remove(ds.root / "dataset.txt", ec);
+            std::cout << "Generating " << ds.count << " images in " << ds.root << "..." << std::endl;
+        }
+
+        ds.files.clear();
+        std::vector<uchar> buf;
+        for (size_t i = 0; i < ds.count; ++i)
+        {
+            cv::RNG rng(ds.seed ^ (0x9e3779b97f4a7c15ull * (i + 1)));
+            std::vector<size_t> labels;
+            std::string name;
+            for (size_t h = 0; h < ds.heads; ++h)
+            {
+                labels.push_back((size_t)rng.uniform(0, (int)ds.classes));
+                name += class_name((char)('a' + h), labels.back(), ds.classes) + '_';
+            }
+
+            std::stringstream idx;
+            idx << std::setw(6) << std::setfill('0') << i;
+            path dir = ds.root / ("part_" + std::to_string(i / 1000));
+            ds.files.push_back((dir / (name + idx.str() + ".jpg")).string());
+
+            if (!generate)
+                continue;
+
+            fs::create_directories(dir, ec);
+            cv::imencode(".jpg", synth_image(ds, i, labels), buf, { cv::IMWRITE_JPEG_QUALITY, ds.quality });
+            if (!cmn::write_file(ds.files.back(), buf))
+                return false;
+        }
+
+        if (generate)
+        {
+            std::ofstream out(ds.root / "dataset.txt");
+            out << stamp.str() << '\n';
+            return (bool)out;
+        }
+
+        return true;
+    }
+
+    cv::Mat seeded_blob(const std::vector<int> & shape, double stddev, cv::RNG & rng)
+    {
+        cv::Mat blob(shape, CV_32F);
+        rng.fill(blob, cv::RNG::NORMAL, cv::Scalar::all(0), cv::Scalar::all(stddev));
+        return blob;
+    }
+
+    // He initialization, inputs are raw 0..255 pixels
+    cv::dnn::LayerParams conv_params(int in, int out, int kernel, int stride, double in_scale, cv::RNG & rng)
+    {
+        cv::dnn::LayerParams lp;
+        lp.set("kernel_size", kernel);
+        lp.set("stride", stride);
+        lp.set("pad", kernel / 2);
+        lp.set("num_output", out);
+        lp.set("bias_term", true);
+        lp.blobs.push_back(seeded_blob({ out, in, kernel, kernel }, std::sqrt(2. / (in * kernel * kernel)) / in_scale, rng));
+        lp.blobs.push_back(seeded_blob({ 1, out }, 0.1, rng));
+        return lp;
+    }
+
+    cv::dnn::LayerParams fc_params(int in, int out, cv::RNG & rng)
+    {
+        cv::dnn::LayerParams lp;
+        lp.set("num_output", out);
+        lp.set("bias_term", true);
+        lp.blobs.push_back(seeded_blob({ out, in }, std::sqrt(2. / in), rng));
+        lp.blobs.push_back(seeded_blob({ 1, out }, 0.1, rng));
+        return lp;
+    }
+
+    /* conv 3x3/2 x2 -> global average pooling -> fc + softmax per head, output layers are named as the class list files */
+    cv::dnn::Net tiny_classifier(const std::vector<cv::String> & heads, size_t classes, uint64 seed)
+    {
+        cv::RNG rng(seed);
+        cv::dnn::Net net;
+        net.setInputsNames({ "data" });
+
+        cv::dnn::LayerParams conv1 = conv_params(3, 16, 3, 2, 255., rng);
+        net.addLayerToPrev("conv1", "Convolution", conv1);
+        cv::dnn::LayerParams relu;
+        net.addLayerToPrev("relu1", "ReLU", relu);
+        cv::dnn::LayerParams conv2 = conv_params(16, 32, 3, 2, 1., rng);
+        net.addLayerToPrev("conv2", "Convolution", conv2);
+        net.addLayerToPrev("relu2", "ReLU", relu);
+
+        cv::dnn::LayerParams pool;
+        pool.set("pool", "ave");
+        pool.set("global_pooling", true);
+        int pool_id = net.addLayerToPrev("pool", "Pooling", pool);
+
+        for (const auto & head : heads)
+        {
+            cv::dnn::LayerParams fc = fc_params(32, (int)classes, rng);
+            int fc_id = net.addLayer(head + "_fc", "InnerProduct", fc);
+            net.connect(pool_id, 0, fc_id, 0);
+
+            cv::dnn::LayerParams softmax;
+            int prob_id = net.addLayer(head, "Softmax", softmax);
+            net.connect(fc_id, 0, prob_id, 0);
+        }
+
+        return net;
+    }
+
+    /* stands in for DetectionOutput: <rows> SSD-style rows per input derived from the features,
+    ** boxes are clustered around a few centres so NMS has overlaps to suppress */
+    class bench_detection_layer_t : public cv::dnn::Layer
+    {
+    public:
+        bench_detection_layer_t(const cv::dnn::LayerParams & params) : cv::dnn::Layer(params), rows(params.get<int>("rows", 100)) {}
+
+        static cv::Ptr<cv::dnn::Layer> create(cv::dnn::LayerParams & params)
+        {
+            return cv::Ptr<cv::dnn::Layer>(new bench_detection_layer_t(params));
+        }
+
+        bool getMemoryShapes(const std::vector<cv::dnn::MatShape> & inputs, const int, std::vector<cv::dnn::MatShape> & outputs, std::vector<cv::dnn::MatShape> &) const override
+        {
+            outputs.assign(1, cv::dnn::MatShape{ 1, 1, inputs[0][0] * rows, 7 });
+            return false;
+        }
+
+        void forward(cv::InputArrayOfArrays inputs_arr, cv::OutputArrayOfArrays outputs_arr, cv::OutputArrayOfArrays) override
+        {
+            std::vector<cv::Mat> inputs, outputs;
+            inputs_arr.getMatVector(inputs);
+            outputs_arr.getMatVector(outputs);
+
+            const cv::Mat & features = inputs[0];
+            const int num = features.size[0];
+            const int channels = features.size[1];
+            const int plane = features.size[2] * features.size[3];
+            float * out = outputs[0].ptr<float>();
+
+            for (int n = 0; n < num; ++n)
+            {
+                const float * f = features.ptr<float>(n);
+                for (int r = 0; r < rows; ++r, out += 7)
+                {
+                    float v = f[(r % channels) * plane + (r * 131) % plane] + r * 0.618034f;
+                    float cx = std::fmod(0.1f + (r % 10) * 0.618034f, 0.8f) + 0.1f + ((r * 37) % 7 - 3) * 0.005f;
+                    float cy = std::fmod(0.2f + (r % 10) * 0.381966f, 0.8f) + 0.1f + ((r * 53) % 7 - 3) * 0.005f;
+                    float half = 0.05f + (r % 5) * 0.01f;
+
+                    out[0] = (float)n;
+                    out[1] = (float)(1 + r % 3);
+                    out[2] = v - std::floor(v);
+                    out[3] = std::max(cx - half, 0.f);
+                    out[4] = std::max(cy - half, 0.f);
+                    out[5] = std::min(cx + half, 1.f);
+                    out[6] = std::min(cy + half, 1.f);
+                }
+            }
+        }
+
+    private:
+        int rows;
+    };
+
+    /* conv 3x3/2 x2 -> max pooling 3/3 -> bench detection output */
+    cv::dnn::Net tiny_detector(int rows, uint64 seed)
+    {
+        cv::RNG rng(seed + 1);
+        cv::dnn::Net net;
+        net.setInputsNames({ "data" });
+
+        cv::dnn::LayerParams conv1 = conv_params(3, 8, 3, 2, 255., rng);
+        net.addLayerToPrev("conv1", "Convolution", conv1);
+        cv::dnn::LayerParams relu;
+        net.addLayerToPrev("relu1", "ReLU", relu);
+        cv::dnn::LayerParams conv2 = conv_params(8, 16, 3, 2, 1., rng);
+        net.addLayerToPrev("conv2", "Convolution", conv2);
+        net.addLayerToPrev("relu2", "ReLU", relu);
+
+        cv::dnn::LayerParams pool;
+        pool.set("pool", "max");
+        pool.set("kernel_size", 3);
+        pool.set("stride", 3);
+        net.addLayerToPrev("pool", "Pooling", pool);
+
+        cv::dnn::LayerParams det;
+        det.set("rows", rows);
+        net.addLayerToPrev("detection_out", "BenchDetection", det);
+
+        return net;
+    }
+
+    /* the keys read by classifier_t::init_params("clf_") and detector_t::init_params() */
+    const char * MODEL_KEYS =
+        "{model||}{weights||}{image_size|300|}{replicas|1|}{threshold||}{nms|0|}{soft_nms|0|}{soft_nms_sigma|0.5|}{top_k|200|}"
+        "{profile_layers|0|}{profile_warmup|0|}{tile_size|0|}{tile_stride|0|}{tile_full|1|}{tile_skip_std|0|}{tile_merge|0.6|}"
+        "{clf_model||}{clf_weights||}{clf_filename_as_labels|1|}{clf_image_size|72|}{clf_replicas|1|}{clf_classifier_mode|1|}"
+        "{clf_classes_0||}{clf_classes_1||}{clf_topk_0|5|}{clf_topk_1|5|}{clf_classifier_threshold_0||}{clf_classifier_threshold_1||}"
+        "{clf_sweep||}{clf_sweep_step|0.05|}{clf_sweep_topk|5|}{clf_profile_layers|0|}{clf_profile_warmup|0|}";
+
+    struct measure_t
+    {
+        std::string mode;
+        std::string unit;
+        size_t images = 0;
+        /* images per second of every timed pass */
+        std::vector<double> rates;
+        cmn::latency_histogram_t latency;
+
+        double median() const
+        {
+            std::vector<double> sorted(rates);
+            std::sort(sorted.begin(), sorted.end());
+            return sorted.empty() ? 0. : sorted[sorted.size() / 2];
+        }
+    };
+
+    /* returns seconds spent in <func>, recorded to <hist> */
+    template <typename func_t>
+    double timed(cmn::latency_histogram_t & hist, func_t func)
+    {
+        auto begin = bench_clock_t::now();
+        func();
+        int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock_t::now() - begin).count();
+        hist.record((uint64_t)std::max<int64_t>(ns, 0));
+        return ns / 1e9;
+    }
+
+    /* <pass> processes <images> and returns the seconds to divide them by */
+    measure_t measure(const std::string & mode, const std::string & unit, size_t images, int warmup, int repeat, const std::function<double(cmn::latency_histogram_t &)> & pass)
+    {
+        measure_t m;
+        m.mode = mode;
+        m.unit = unit;
+        m.images = images;
+
+        for (int i = 0; i < warmup; ++i)
+        {
+            cmn::latency_histogram_t discarded;
+            pass(discarded);
+        }
+
+        for (int i = 0; i < repeat; ++i)
+        {
+            double sec = pass(m.latency);
+            m.rates.push_back(sec > 0. ? images / sec : 0.);
+        }
+
+        auto minmax = std::minmax_element(m.rates.begin(), m.rates.end());
+        double median = m.median();
+        std::cout
+            << std::left << std::setw(16) << m.mode << std::right
+            << std::fixed << std::setprecision(1)
+            << " | " << std::setw(10) << median << " img/s"
+            << " [" << std::setw(10) << *minmax.first << ", " << std::setw(10) << *minmax.second << "]"
+            << " spread " << std::setw(5) << (median > 0. ? 100. * (*minmax.second - *minmax.first) / median : 0.) << '%'
+            << " | per " << std::left << std::setw(5) << m.unit << std::right << std::setprecision(3)
+            << " p50 " << std::setw(9) << m.latency.percentile(0.5) / 1e6
+            << " p95 " << std::setw(9) << m.latency.percentile(0.95) / 1e6
+            << " p99 " << std::setw(9) << m.latency.percentile(0.99) / 1e6 << " ms" << std::endl;
+
+        return m;
+    }
+
+    // one mode per line, so read_baseline() doesn't need a json parser
+    bool save_json(const std::string & filename, const dataset_t & ds, size_t batch_size, const std::vector<measure_t> & results)
+    {
+        std::ofstream out(filename);
+        if (!out.is_open())
+            return false;
+
+        out << "{\n"
+            << "  \"count\": " << ds.count << ", \"width\": " << ds.size.width << ", \"height\": " << ds.size.height
+            << ", \"quality\": " << ds.quality << ", \"classes\": " << ds.classes << ", \"heads\": " << ds.heads
+            << ", \"seed\": " << ds.seed << ", \"batch_size\": " << batch_size << ",\n"
+            << "  \"modes\": [";
+        for (size_t i = 0; i < results.size(); ++i)
+        {
+            const auto & m = results[i];
+            auto minmax = std::minmax_element(m.rates.begin(), m.rates.end());
+            out << (i ? "," : "") << "\n    { \"mode\": \"" << m.mode << "\", \"unit\": \"" << m.unit << "\", \"images\": " << m.images
+                << ", \"images_per_s\": " << m.median() << ", \"min_images_per_s\": " << *minmax.first << ", \"max_images_per_s\": " << *minmax.second
+                << ", \"p50_ns\": " << m.latency.percentile(0.5) << ", \"p95_ns\": " << m.latency.percentile(0.95)
+                << ", \"p99_ns\": " << m.latency.percentile(0.99) << ", \"max_ns\": " << m.latency.max() << " }";
+        }
+        out << "\n  ]\n}\n";
+
+        return (bool)out;
+    }
+
+    bool read_baseline(const std::string & filename, std::map<std::string, double> & rates)
+    {
+        std::ifstream in(filename);
+        if (!in.is_open())
+            return false;
+
+        const std::string mode_key = "\"mode\": \"";
+        const std::string rate_key = "\"images_per_s\": ";
+        std::string line;
+        while (std::getline(in, line))
+        {
+            size_t mode = line.find(mode_key);
+            size_t rate = line.find(rate_key);
+            if (mode == std::string::npos || rate == std::string::npos)
+                continue;
+
+            mode += mode_key.size();
+            rates[line.substr(mode, line.find('"', mode) - mode)] = std::atof(line.c_str() + rate + rate_key.size());
+        }
+
+        return true;
+    }
+
+    struct task_t
+    {
+        size_t idx;
+        bench_clock_t::time_point begin;
+        cv::Mat img;
+    };
+
+    /* decode pool -> batched inference -> completion, latency is from push to completion, so it includes queueing */
+    double run_pipeline(const dataset_t & ds, const cmn::pipeline_settings_t & settings, cmn::latency_histogram_t & hist, const std::function<void(std::vector<task_t *> &)> & infer)
+    {
+        std::mutex hist_mutex;
+        auto begin = bench_clock_t::now();
+
+        cmn::pipeline_t<task_t> pipeline;
+        pipeline.start(settings,
+            [&](task_t & task)
+            {
+                thread_local std::vector<uchar> buf;
+                if (!cmn::read_file(ds.files[task.idx], buf))
+                    return false;
+                task.img = cv::imdecode(buf, cv::IMREAD_COLOR);
+                return !task.img.empty();
+            },
+            infer,
+            [&](task_t & task)
+            {
+                task.img.release();
+                int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(bench_clock_t::now() - task.begin).count();
+                std::lock_guard<std::mutex> lg(hist_mutex);
+                hist.record((uint64_t)std::max<int64_t>(ns, 0));
+            });
+
+        for (size_t i = 0; i < ds.files.size(); ++i)
+        {
+            std::unique_ptr<task_t> task(new task_t);
+            task->idx = i;
+            task->begin = bench_clock_t::now();
+            pipeline.push(std::move(task));
+        }
+        pipeline.finish();
+
+        return std::chrono::duration<double>(bench_clock_t::now() - begin).count();
+    }
+
+    /* calls <func>(first, n) per batch of <batch_size> over <count> images */
+    void for_batches(size_t count, size_t batch_size, const std::function<void(size_t, size_t)> & func)
+    {
+        for (size_t first = 0; first < count; first += batch_size)
+            func(first, std::min(batch_size, count - first));
+    }
+
+    std::vector<cv::Mat> cycled(const std::vector<cv::Mat> & sample, size_t first, size_t n)
+    {
+        std::vector<cv::Mat> batch;
+        for (size_t i = first; i < first + n; ++i)
+            batch.push_back(sample[i % sample.size()]);
+        return batch;
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    cv::CommandLineParser cmd(argc, argv,
+        "{help h||help message}"
+        "{data|bench_data|synthetic dataset directory, generated on the first run and reused while the parameters below match}"
+        "{count|512|number of images}"
+        "{width|640|image width}"
+        "{height|480|image height}"
+        "{quality|90|JPEG quality}"
+        "{classes|10|classes per head}"
+        "{heads|2|labels per filename and classifier heads, 1 or 2}"
+        "{seed|1|seed of images, labels and network weights}"
+        "{modes|all|comma separated subset of decode, preprocess, inference, stats, classifier, detector (all - every mode)}"
+        "{repeat|5|timed passes per mode, the median is reported}"
+        "{warmup|1|untimed passes per mode}"
+        "{sample|64|decoded images cycled by the isolated preprocess, inference and stats modes}"
+        "{batch_size|8|network batch size}"
+        "{replicas|1|network replicas}"
+        "{decode_threads|4|decode threads of the end-to-end modes}"
+        "{infer_threads|1|inference threads of the end-to-end modes}"
+        "{cv_threads|1|OpenCV threads, 1 keeps the numbers comparable between runs}"
+        "{clf_image_size|72|classifier input size}"
+        "{image_size|300|detector input size}"
+        "{det_rows|100|detector output rows per input}"
+        "{threshold|0.3|detector threshold}"
+        "{nms|0.45|IoU threshold of detector NMS}"
+        "{json||path to output .json with the results}"
+        "{baseline||.json of a previous run, exits with 1 if a mode is slower than it by more than <tolerance>}"
+        "{tolerance|0.1|allowed relative throughput loss against <baseline>}"
+    );
+    cmd.about("Pipeline benchmark: classifier and detector throughput on a synthetic dataset, end to end and per stage.");
+
+    if (cmd.has("help"))
+    {
+        cmd.printMessage();
+        return EXIT_SUCCESS;
+    }
+
+    dataset_t ds;
+    ds.root = path(cmd.get<std::string>("data"));
+    ds.count = std::max<size_t>(cmd.get<size_t>("count"), 1u);
+    ds.size = cv::Size(std::max(cmd.get<int>("width"), 16), std::max(cmd.get<int>("height"), 16));
+    ds.quality = cmd.get<int>("quality");
+    ds.classes = std::max<size_t>(cmd.get<size_t>("classes"), 1u);
+    ds.heads = cmd.get<size_t>("heads");
+    ds.seed = cmd.get<uint64>("seed");
+    if (ds.heads < 1 || ds.heads > 2)
+    {
+        std::cerr << "Wrong value <heads>=" << ds.heads << ". Allowed values: 1, 2.\n";
+        return EXIT_FAILURE;
+    }
+
+    const int repeat = std::max(cmd.get<int>("repeat"), 1);
+    const int warmup = std::max(cmd.get<int>("warmup"), 0);
+    const size_t batch_size = std::max<size_t>(cmd.get<size_t>("batch_size"), 1u);
+    const size_t replicas = std::max<size_t>(cmd.get<size_t>("replicas"), 1u);
+    const int det_rows = std::max(cmd.get<int>("det_rows"), 1);
+
+    std::string modes = "," + cmd.get<std::string>("modes") + ",";
+    auto enabled = [&](const std::string & mode) { return modes == ",all," || modes.find("," + mode + ",") != std::string::npos; };
+
+    cv::setNumThreads(cmd.get<int>("cv_threads"));
+
+    if (!make_dataset(ds))
+    {
+        std::cerr << "Failed to generate the dataset in " << ds.root << ".\n";
+        return EXIT_FAILURE;
+    }
+
+    // the tools' own parameter parsing, fed with the bench settings and the generated class lists
+    std::vector<std::string> args = {
+        "pipeline_bench",
+        "--model=builtin", "--weights=builtin",
+        "--image_size=" + cmd.get<std::string>("image_size"),
+        "--replicas=" + std::to_string(replicas),
+        "--threshold=" + cmd.get<std::string>("threshold"),
+        "--nms=" + cmd.get<std::string>("nms"),
+        "--clf_model=builtin", "--clf_weights=builtin",
+        "--clf_image_size=" + cmd.get<std::string>("clf_image_size"),
+        "--clf_replicas=" + std::to_string(replicas),
+        "--clf_classifier_mode=" + std::to_string(ds.heads)
+    };
+    for (size_t h = 0; h < ds.heads; ++h)
+        args.push_back("--clf_classes_" + std::to_string(h) + "=" + ds.class_files[h].string());
+    std::vector<const char *> model_argv;
+    for (const auto & a : args)
+        model_argv.push_back(a.c_str());
+    cv::CommandLineParser model_cmd((int)model_argv.size(), model_argv.data(), MODEL_KEYS);
+
+    cv::dnn::LayerFactory::registerLayer("BenchDetection", bench_detection_layer_t::create);
+
+    clf_t classifier;
+    detector::detector_t detector;
+    if (!classifier.init_params(model_cmd, "clf_") || !detector.init_params(model_cmd))
+        return EXIT_FAILURE;
+
+    std::vector<cv::String> heads(classifier.outlayers_names.begin(), classifier.outlayers_names.end());
+    uint64 seed = ds.seed;
+    if (!classifier.classifier.load([&]() { return tiny_classifier(heads, ds.classes, seed); }, replicas)
+        || !detector.net.load([&]() { return tiny_detector(det_rows, seed); }, replicas))
+    {
+        std::cerr << "Failed to build the networks.\n";
+        return EXIT_FAILURE;
+    }
+
+    cmn::pipeline_settings_t settings;
+    settings.decode_threads = cmd.get<size_t>("decode_threads");
+    settings.infer_threads = cmd.get<size_t>("infer_threads");
+    settings.encode_threads = 1;
+    settings.batch_size = batch_size;
+
+    // decoded once, the isolated modes cycle over it
+    std::vector<cv::Mat> sample(std::min<size_t>(std::max<size_t>(cmd.get<size_t>("sample"), 1u), ds.count));
+    for (size_t i = 0; i < sample.size(); ++i)
+        sample[i] = cv::imread(ds.files[i], cv::IMREAD_COLOR);
+
+    cmn::preprocess_param_t clf_pre;
+    clf_pre.size = cv::Size((int)classifier.params.image_size, (int)classifier.params.image_size);
+    clf_pre.scale_factor = classifier.params.scale_factor;
+    clf_pre.mean = classifier.params.mean;
+    clf_pre.swap_RB = classifier.params.swap_RB;
+    clf_pre.crop = classifier.params.crop;
+    clf_pre.ddepth = classifier.params.ddepth;
+
+    cmn::preprocess_param_t det_pre;
+    det_pre.size = cv::Size((int)detector.params.image_size, (int)detector.params.image_size);
+    det_pre.scale_factor = detector.params.scale_factor;
+    det_pre.mean = detector.params.mean;
+    det_pre.swap_RB = detector.params.inverse_channels;
+    det_pre.crop = detector.params.crop;
+    det_pre.ddepth = detector.params.ddepth;
+
+    std::cout << ds.count << " images " << ds.size.width << 'x' << ds.size.height << " q" << ds.quality
+        << ", " << ds.heads << " x " << ds.classes << " classes, batch " << batch_size << ", replicas " << replicas
+        << ", " << repeat << " passes per mode\n";
+
+    std::vector<measure_t> results;
+
+    if (enabled("decode"))
+        results.push_back(measure("decode", "image", ds.count, warmup, repeat, [&](cmn::latency_histogram_t & hist)
+        {
+            double sec = 0.;
+            std::vector<uchar> buf;
+            for (const auto & file : ds.files)
+                sec += timed(hist, [&]() { cmn::read_file(file, buf); cv::imdecode(buf, cv::IMREAD_COLOR); });
+            return sec;
+        }));
+
+    if (enabled("preprocess"))
+    {
+        for (const auto & p : { std::make_pair(std::string("clf_preprocess"), &clf_pre), std::make_pair(std::string("det_preprocess"), &det_pre) })
+            results.push_back(measure(p.first, "batch", ds.count, warmup, repeat, [&](cmn::latency_histogram_t & hist)
+            {
+                double sec = 0.;
+                cv::Mat blob;
+                for_batches(ds.count, batch_size, [&](size_t first, size_t n)
+                {
+                    std::vector<cv::Mat> batch = cycled(sample, first, n);
+                    sec += timed(hist, [&]() { cmn::blob_from_images(batch, blob, *p.second); });
+                });
+                return sec;
+            }));
+    }
+
+    if (enabled("inference"))
+    {
+        results.push_back(measure("clf_inference", "batch", ds.count, warmup, repeat, [&](cmn::latency_histogram_t & hist)
+        {
+            double sec = 0.;
+            cv::Mat blob;
+            std::vector<cv::Mat> out;
+            for_batches(ds.count, batch_size, [&](size_t first, size_t n)
+            {
+                cmn::blob_from_images(cycled(sample, first, n), blob, clf_pre);
+                auto lease = classifier.classifier.acquire();
+                sec += timed(hist, [&]() { lease.net().setInput(blob); lease.net().forward(out, classifier.outlayers_names); });
+            });
+            return sec;
+        }));
+
+        results.push_back(measure("det_inference", "batch", ds.count, warmup, repeat, [&](cmn::latency_histogram_t & hist)
+        {
+            double sec = 0.;
+            cv::Mat blob;
+            for_batches(ds.count, batch_size, [&](size_t first, size_t n)
+            {
+                cmn::blob_from_images(cycled(sample, first, n), blob, det_pre);
+                auto lease = detector.net.acquire();
+                sec += timed(hist, [&]() { lease.net().setInput(blob); lease.net().forward(); });
+            });
+            return sec;
+        }));
+    }
+
+    if (enabled("stats"))
+    {
+        // recorded network outputs of the sample, ground truth comes from the names of the files they are assigned to
+        std::vector<cv::Mat> scores;
+        classifier.forward_batch(sample, scores);
+        std::vector<std::vector<float>> rows;
+        detector.forward_batch(sample, rows);
+
+        results.push_back(measure("clf_stats", "image", ds.count, warmup, repeat, [&](cmn::latency_histogram_t & hist)
+        {
+            double sec = 0.;
+            std::vector<cv::Mat> row(scores.size());
+            clf_t::clf_res_t result;
+            for (size_t i = 0; i < ds.count; ++i)
+            {
+                path file(ds.files[i]);
+                for (size_t h = 0; h < scores.size(); ++h)
+                    row[h] = scores[h].row((int)(i % sample.size()));
+                sec += timed(hist, [&]() { classifier.process_output(file, row, result); });
+            }
+            return sec;
+        }));
+
+        results.push_back(measure("det_postprocess", "image", ds.count, warmup, repeat, [&](cmn::latency_histogram_t & hist)
+        {
+            double sec = 0.;
+            std::vector<detector::detector_t::det_res_t> dets;
+            for (size_t i = 0; i < ds.count; ++i)
+            {
+                const auto & r = rows[i % sample.size()];
+                const cv::Size size = sample[i % sample.size()].size();
+                sec += timed(hist, [&]() { detector.process_output(r.data(), r.size() / detector::detector_t::ROW_SIZE, size, dets); });
+            }
+            return sec;
+        }));
+    }
+
+    if (enabled("classifier"))
+        results.push_back(measure("classifier", "image", ds.count, warmup, repeat, [&](cmn::latency_histogram_t & hist)
+        {
+            return run_pipeline(ds, settings, hist, [&](std::vector<task_t *> & batch)
+            {
+                std::vector<cv::Mat> imgs;
+                for (auto t : batch)
+                    imgs.push_back(t->img);
+
+                std::vector<cv::Mat> out;
+                classifier.forward_batch(imgs, out);
+
+                std::vector<cv::Mat> row(out.size());
+                clf_t::clf_res_t result;
+                for (size_t i = 0; i < batch.size(); ++i)
+                {
+                    for (size_t h = 0; h < out.size(); ++h)
+                        row[h] = out[h].row((int)i);
+                    classifier.process_output(path(ds.files[batch[i]->idx]), row, result);
+                }
+            });
+        }));
+
+    if (enabled("detector"))
+        results.push_back(measure("detector", "image", ds.count, warmup, repeat, [&](cmn::latency_histogram_t & hist)
+        {
+            return run_pipeline(ds, settings, hist, [&](std::vector<task_t *> & batch)
+            {
+                std::vector<cv::Mat> imgs;
+                for (auto t : batch)
+                    imgs.push_back(t->img);
+
+                std::vector<std::vector<float>> rows;
+                detector.forward_batch(imgs, rows);
+
+                std::vector<detector::detector_t::det_res_t> dets;
+                for (size_t i = 0; i < batch.size(); ++i)
+                    detector.process_output(rows[i].data(), rows[i].size() / detector::detector_t::ROW_SIZE, imgs[i].size(), dets);
+            });
+        }));
+
+    if (cmd.has("json") && !save_json(cmd.get<std::string>("json"), ds, batch_size, results))
+    {
+        std::cerr << "Failed to save " << cmd.get<std::string>("json") << ".\n";
+        return EXIT_FAILURE;
+    }
+
+    if (cmd.has("baseline"))
+    {
+        std::map<std::string, double> baseline;
+        if (!read_baseline(cmd.get<std::string>("baseline"), baseline))
+        {
+            std::cerr << "Failed to read " << cmd.get<std::string>("baseline") << ".\n";
+            return EXIT_FAILURE;
+        }
+
+        double tolerance = cmd.get<double>("tolerance");
+        bool regressed = false;
+        for (const auto & m : results)
+        {
+            auto b = baseline.find(m.mode);
+            if (b == baseline.end() || b->second <= 0.)
+                continue;
+
+            double change = m.median() / b->second - 1.;
+            std::cout << std::left << std::setw(16) << m.mode << std::right << " | " << std::showpos << std::setprecision(1) << 100. * change << std::noshowpos << "% vs baseline"
+                << (change < -tolerance ? "  REGRESSION" : "") << '\n';
+            regressed = regressed || change < -tolerance;
+        }
+
+        if (regressed)
+            return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,95 @@
+#include "../common/preprocess.h"
+
+#include <opencv2/dnn.hpp>
+
+#include <functional>
+#include <iomanip>
+#include <iostream>
+
+/* compares cmn::blob_from_images() with cv::dnn::blobFromImages()
+** at the default classifier (72 px) and detector (300 px) input sizes */
+
+namespace
+{
+    double bench_ms(int iters, const std::function<void()> & func)
+    {
+        func(); // warm-up
+
+        int64 start = cv::getTickCount();
+        for (int i = 0; i < iters; ++i)
+            func();
+        return 1000. * (cv::getTickCount() - start) / cv::getTickFrequency() / iters;
+    }
+
+    void run(const std::vector<cv::Mat> & imgs, const cmn::preprocess_param_t & params, int iters)
+    {
+        cv::Mat ref, blob;
+
+        double ref_ms = bench_ms(iters, [&]()
+        {
+            ref = cv::dnn::blobFromImages(imgs, params.scale_factor, params.size, params.mean, params.swap_RB, params.crop, params.ddepth);
+        });
+        double blob_ms = bench_ms(iters, [&]() { cmn::blob_from_images(imgs, blob, params); });
+
+        double max_diff = cv::norm(ref.reshape(1, 1), blob.reshape(1, 1), cv::NORM_INF);
+
+        std::cout
+            << std::setw(5) << imgs[0].cols << 'x' << std::setw(4) << imgs[0].rows
+            << " -> " << std::setw(3) << params.size.width
+            << " batch " << std::setw(2) << imgs.size()
+            << (params.crop ? " crop" : "     ")
+            << " | blobFromImages " << std::setw(8) << std::fixed << std::setprecision(3) << ref_ms << " ms"
+            << " | blob_from_images " << std::setw(8) << blob_ms << " ms"
+            << " | x" << std::setprecision(2) << ref_ms / blob_ms
+            << " | max diff " << std::setprecision(4) << max_diff << '\n';
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    cv::CommandLineParser cmd(argc, argv,
+        "{help h||help message}"
+        "{iters|200|iterations per measurement}"
+    );
+    cmd.about("Preprocessing benchmark: cmn::blob_from_images() vs cv::dnn::blobFromImages().");
+
+    if (cmd.has("help"))
+    {
+        cmd.printMessage();
+        return EXIT_SUCCESS;
+    }
+
+    int iters = cmd.get<int>("iters");
+    cv::RNG rng(0x5eed);
+
+    const std::vector<cv::Size> sources = { cv::Size(72, 72), cv::Size(300, 300), cv::Size(640, 480), cv::Size(1920, 1080) };
+    const std::vector<int> input_sizes = { 72, 300 };
+    const std::vector<size_t> batches = { 1, 8 };
+
+    for (const auto & src_size : sources)
+    {
+        std::vector<cv::Mat> all(batches.back());
+        for (auto & img : all)
+        {
+            img.create(src_size, CV_8UC3);
+            rng.fill(img, cv::RNG::UNIFORM, cv::Scalar::all(0), cv::Scalar::all(256));
+        }
+
+        for (int input_size : input_sizes)
+            for (size_t batch : batches)
+                for (bool crop : { false, true })
+                {
+                    cmn::preprocess_param_t params;
+                    params.size = cv::Size(input_size, input_size);
+                    params.scale_factor = 1. / 255;
+                    params.mean = cv::Scalar(104, 117, 123);
+                    params.swap_RB = true;
+                    params.crop = crop;
+                    params.ddepth = CV_32F;
+
+                    run(std::vector<cv::Mat>(all.begin(), all.begin() + batch), params, iters);
+                }
+    }
+
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,93 @@
+#include "../common/topk.h"
+
+#include <opencv2/core.hpp>
+
+#include <algorithm>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+
+/* compares cmn::topk() with filling and sorting the whole prediction vector,
+** as classifier_t::process_output() did, over class counts from 10 to 100k */
+
+namespace
+{
+    double bench_us(int iters, const std::function<void()> & func)
+    {
+        func(); // warm-up
+
+        int64 start = cv::getTickCount();
+        for (int i = 0; i < iters; ++i)
+            func();
+        return 1e6 * (cv::getTickCount() - start) / cv::getTickFrequency() / iters;
+    }
+
+    void run(const cv::Mat & softmax, size_t k, int iters)
+    {
+        const size_t n = (size_t)softmax.cols;
+        const float * data = softmax.ptr<float>();
+
+        std::vector<cmn::score_t> ref;
+        double sort_us = bench_us(iters, [&]()
+        {
+            std::vector<cmn::score_t> pred(n);
+            for (size_t j = 0; j < n; ++j)
+                pred[j] = std::make_pair(j, softmax.at<float>(0, (int)j));
+            std::sort(pred.begin(), pred.end(), [](const cmn::score_t & l, const cmn::score_t & r) { return l.second > r.second; });
+            ref.assign(pred.begin(), pred.begin() + std::min(k, n));
+        });
+
+        std::vector<cmn::score_t> out;
+        double topk_us = bench_us(iters, [&]() { cmn::topk(data, n, k, out); });
+
+        bool same = ref.size() == out.size();
+        for (size_t i = 0; same && i < ref.size(); ++i)
+            same = ref[i].second == out[i].second;
+
+        std::cout
+            << "classes " << std::setw(6) << n
+            << " k " << std::setw(3) << k
+            << " | full sort " << std::setw(10) << std::fixed << std::setprecision(2) << sort_us << " us"
+            << " | topk " << std::setw(8) << topk_us << " us"
+            << " | x" << std::setw(7) << std::setprecision(1) << sort_us / topk_us
+            << (same ? "" : " | MISMATCH") << '\n';
+    }
+}
+
+int main(int argc, char ** argv)
+{
+    cv::CommandLineParser cmd(argc, argv,
+        "{help h||help message}"
+        "{iters|1000|iterations per measurement}"
+    );
+    cmd.about("Top-k benchmark: cmn::topk() vs full sort of the prediction vector.");
+
+    if (cmd.has("help"))
+    {
+        cmd.printMessage();
+        return EXIT_SUCCESS;
+    }
+
+    int iters = cmd.get<int>("iters");
+    cv::RNG rng(0x5eed);
+
+    const std::vector<int> class_counts = { 10, 100, 1000, 10000, 100000 };
+    const std::vector<size_t> ks = { 1, 5, 20, 100 };
+
+    for (int n : class_counts)
+    {
+        // softmax-like: a few strong classes over a long tail
+        cv::Mat logits(1, n, CV_32F);
+        rng.fill(logits, cv::RNG::NORMAL, 0., 3.);
+        cv::Mat softmax;
+        cv::exp(logits, softmax);
+        softmax /= cv::sum(softmax)[0];
+
+        // keep the total work per measurement roughly constant
+        int n_iters = std::max(1, (int)(iters * 1000LL / std::max(n, 1000)));
+        for (size_t k : ks)
+            run(softmax, k, n_iters);
+    }
+
+    return EXIT_SUCCESS;
+}
\ No newline at end of file
@@ -0,0 +1,372 @@
+#include "archive_reader.h"
+#include "image_io.h"
+
+#include <logger.h>
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+namespace cmn
+{
+    using LL = logger::LOG_LEVEL_t;
+
+    namespace
+    {
+        const size_t TAR_BLOCK = 512;
+        const size_t READ_BUFFER_SIZE = 1 << 20;
+
+        const uint32_t ZIP_LOCAL_SIG = 0x04034b50;
+        const uint32_t ZIP_CENTRAL_SIG = 0x02014b50;
+        const uint32_t ZIP_END_SIG = 0x06054b50;
+        const size_t ZIP_LOCAL_SIZE = 30;
+        const size_t ZIP_CENTRAL_SIZE = 46;
+        const size_t ZIP_END_SIZE = 22;
+        const size_t ZIP_MAX_COMMENT = 0xffff;
+
+        inline uint16_t le16(const unsigned char * p) { return (uint16_t)(p[0] | (p[1] << 8)); }
+        inline uint32_t le32(const unsigned char * p) { return (uint32_t)le16(p) | ((uint32_t)le16(p + 2) << 16); }
+
+        /* octal, or base-256 for GNU large sizes */
+        uint64_t tar_number(const char * field, size_t len)
+        {
+            uint64_t value = 0;
+            if ((unsigned char)field[0] & 0x80)
+            {
+                for (size_t i = 1; i < len; ++i)
+                    value = (value << 8) | (unsigned char)field[i];
+                return value;
+            }
+
+            for (size_t i = 0; i < len && field[i]; ++i)
+                if (field[i] >= '0' && field[i] <= '7')
+                    value = (value << 3) | (uint64_t)(field[i] - '0');
+            return value;
+        }
+
+        std::string tar_string(const char * field, size_t len)
+        {
+            return std::string(field, std::find(field, field + len, '\0'));
+        }
+
+        bool tar_checksum(const char * header)
+        {
+            uint64_t sum = 0;
+            for (size_t i = 0; i < TAR_BLOCK; ++i)
+                sum += (i >= 148 && i < 156) ? (unsigned char)' ' : (unsigned char)header[i];
+            return sum == tar_number(header + 148, 8);
+        }
+
+        /* "<len> path=<value>\n" record of a pax extended header */
+        std::string pax_path(const std::string & records)
+        {
+            size_t pos = 0;
+            while (pos < records.size())
+            {
+                size_t space = records.find(' ', pos);
+                if (space == std::string::npos)
+                    break;
+
+                size_t len = std::strtoul(records.c_str() + pos, nullptr, 10);
+                if (len == 0 || pos + len > records.size())
+                    break;
+
+                std::string record = records.substr(space + 1, pos + len - space - 2);
+                if (record.compare(0, 5, "path=") == 0)
+                    return record.substr(5);
+                pos += len;
+            }
+
+            return std::string();
+        }
+
+        /* relative '/' separated path, so that members cannot escape the output directory
+        ** leading separators and drive prefixes are stripped, empty if a component is ".." */
+        std::string safe_name(const std::string & name)
+        {
+            std::string res = name;
+            std::replace(res.begin(), res.end(), '\\', '/');
+            if (res.size() >= 2 && res[1] == ':' && std::isalpha((unsigned char)res[0]))
+                res.erase(0, 2);
+            res.erase(0, res.find_first_not_of('/'));
+
+            for (size_t pos = 0; pos < res.size();)
+            {
+                size_t slash = std::min(res.find('/', pos), res.size());
+                if (res.compare(pos, slash - pos, "..") == 0 && slash - pos == 2)
+                    return std::string();
+                pos = slash + 1;
+            }
+
+            return res;
+        }
+    }
+
+    bool archive_reader_t::is_archive(const std::string & filename)
+    {
+        std::string ext = lower_ext(filename);
+        return ext == ".tar" || ext == ".zip";
+    }
+
+    bool archive_reader_t::open(const std::string & filename, size_t prefetch)
+    {
+        close();
+
+        if (!is_archive(filename))
+            return false;
+
+        this->filename = filename;
+        format = filename.back() == 'p' || filename.back() == 'P' ? ZIP : TAR;
+
+        // large sequential reads, libstdc++ ignores a buffer set after open()
+        read_buffer.resize(READ_BUFFER_SIZE);
+        file.rdbuf()->pubsetbuf(read_buffer.data(), (std::streamsize)read_buffer.size());
+        file.open(filename, std::ios::binary);
+        if (!file.is_open())
+            return false;
+
+        failed = false;
+        queue.reset(new bounded_queue_t<std::unique_ptr<member_t>>(std::max<size_t>(prefetch, 2u)));
+        reader = std::thread([this]()
+        {
+            if (format == TAR)
+                read_tar();
+            else
+                read_zip();
+
+            queue->close();
+            file.close();
+        });
+
+        return true;
+    }
+
+    void archive_reader_t::close()
+    {
+        if (queue)
+            queue->close();
+        if (reader.joinable())
+            reader.join();
+        queue.reset();
+        if (file.is_open())
+            file.close();
+    }
+
+    bool archive_reader_t::next(member_t & member)
+    {
+        std::unique_ptr<member_t> m;
+        if (!queue || !queue->pop(m))
+            return false;
+
+        member = std::move(*m);
+        return true;
+    }
+
+    bool archive_reader_t::emit(std::unique_ptr<member_t> && member)
+    {
+        // false once the consumer has closed the reader
+        return queue->push(std::move(member));
+    }
+
+    void archive_reader_t::fail(const std::string & msg)
+    {
+        failed = true;
+        logger::LOG_MSG(LL::Error, msg + ": " + filename);
+    }
+
+    void archive_reader_t::read_tar()
+    {
+        char header[TAR_BLOCK];
+        std::string long_name;
+
+        while (true)
+        {
+            if (!file.read(header, TAR_BLOCK))
+            {
+                // archives cut right after a member are accepted, as tar itself does
+                if (file.gcount() != 0)
+                    fail("Truncated tar header");
+                return;
+            }
+
+            if (std::all_of(header, header + TAR_BLOCK, [](char c) { return c == '\0'; }))
+                return;
+
+            if (!tar_checksum(header))
+            {
+                fail("Malformed tar header");
+                return;
+            }
+
+            uint64_t size = tar_number(header + 124, 12);
+            uint64_t padded = (size + TAR_BLOCK - 1) / TAR_BLOCK * TAR_BLOCK;
+            char type = header[156];
+
+            if (type == 'L' || type == 'x' || type == '0' || type == '\0' || type == '7')
+            {
+                std::unique_ptr<member_t> member(new member_t);
+                member->data.resize((size_t)size);
+                if (!file.read((char *)member->data.data(), (std::streamsize)size) ||
+                    !file.ignore((std::streamsize)(padded - size)))
+                {
+                    fail("Truncated tar member");
+                    return;
+                }
+
+                if (type == 'L')
+                {
+                    long_name = tar_string((const char *)member->data.data(), member->data.size());
+                    continue;
+                }
+                if (type == 'x')
+                {
+                    long_name = pax_path(std::string(member->data.begin(), member->data.end()));
+                    continue;
+                }
+
+                if (!long_name.empty())
+                    member->name.swap(long_name);
+                else
+                {
+                    member->name = tar_string(header, 100);
+                    std::string prefix = tar_string(header + 345, 155);
+                    if (std::memcmp(header + 257, "ustar", 5) == 0 && !prefix.empty())
+                        member->name = prefix + '/' + member->name;
+                }
+                long_name.clear();
+
+                std::string name = safe_name(member->name);
+                if (name.empty())
+                {
+                    logger::LOG_MSG(LL::Warning, "Tar member with an unsafe path is skipped: " + member->name);
+                    continue;
+                }
+                member->name.swap(name);
+
+                if (!emit(std::move(member)))
+                    return;
+            }
+            else
+            {
+                // directories, links, global pax headers
+                long_name.clear();
+                if (!file.ignore((std::streamsize)padded))
+                {
+                    fail("Truncated tar member");
+                    return;
+                }
+            }
+        }
+    }
+
+    void archive_reader_t::read_zip()
+    {
+        struct entry_t
+        {
+            std::string name;
+            uint32_t offset;
+            uint32_t size;
+            uint16_t method;
+        };
+
+        // end of central directory record, followed by an optional comment
+        file.seekg(0, std::ios::end);
+        uint64_t file_size = (uint64_t)file.tellg();
+        size_t tail_size = (size_t)std::min<uint64_t>(file_size, ZIP_END_SIZE + ZIP_MAX_COMMENT);
+
+        std::vector<unsigned char> tail(tail_size);
+        file.seekg((std::streamoff)(file_size - tail_size));
+        if (tail_size < ZIP_END_SIZE || !file.read((char *)tail.data(), (std::streamsize)tail_size))
+        {
+            fail("Malformed zip archive");
+            return;
+        }
+
+        size_t end = tail_size - ZIP_END_SIZE + 1;
+        while (end-- > 0 && le32(tail.data() + end) != ZIP_END_SIG);
+        if (end == (size_t)-1)
+        {
+            fail("Zip end of central directory not found");
+            return;
+        }
+
+        uint16_t num_entries = le16(tail.data() + end + 10);
+        uint32_t dir_size = le32(tail.data() + end + 12);
+        uint32_t dir_offset = le32(tail.data() + end + 16);
+        if (num_entries == 0xffff || dir_offset == 0xffffffff || (uint64_t)dir_offset + dir_size > file_size)
+        {
+            fail("Zip64 archives are not supported");
+            return;
+        }
+
+        std::vector<unsigned char> dir(dir_size);
+        file.seekg(dir_offset);
+        if (!file.read((char *)dir.data(), dir_size))
+        {
+            fail("Truncated zip central directory");
+            return;
+        }
+
+        std::vector<entry_t> entries;
+        entries.reserve(num_entries);
+        for (size_t pos = 0; pos + ZIP_CENTRAL_SIZE <= dir.size() && le32(dir.data() + pos) == ZIP_CENTRAL_SIG;)
+        {
+            const unsigned char * p = dir.data() + pos;
+            size_t name_len = le16(p + 28);
+            size_t entry_len = ZIP_CENTRAL_SIZE + name_len + le16(p + 30) + le16(p + 32);
+            if (pos + entry_len > dir.size())
+                break;
+
+            entry_t entry;
+            entry.name.assign((const char *)p + ZIP_CENTRAL_SIZE, name_len);
+            entry.method = le16(p + 10);
+            entry.size = le32(p + 20);
+            entry.offset = le32(p + 42);
+            pos += entry_len;
+            if (entry.name.empty() || entry.name.back() == '/')
+                continue;
+
+            std::string name = safe_name(entry.name);
+            if (name.empty())
+            {
+                logger::LOG_MSG(LL::Warning, "Zip member with an unsafe path is skipped: " + entry.name);
+                continue;
+            }
+            entry.name.swap(name);
+            entries.push_back(entry);
+        }
+
+        // members in file order, so reads stay sequential
+        std::sort(entries.begin(), entries.end(), [](const entry_t & l, const entry_t & r) { return l.offset < r.offset; });
+
+        unsigned char local[ZIP_LOCAL_SIZE];
+        for (const auto & entry : entries)
+        {
+            if (entry.method != 0)
+            {
+                logger::LOG_MSG(LL::Warning, "Compressed zip member is skipped, only stored members are supported: " + entry.name);
+                continue;
+            }
+
+            file.seekg(entry.offset);
+            if (!file.read((char *)local, ZIP_LOCAL_SIZE) || le32(local) != ZIP_LOCAL_SIG)
+            {
+                fail("Malformed zip local header");
+                return;
+            }
+            file.seekg(le16(local + 26) + le16(local + 28), std::ios::cur);
+
+            std::unique_ptr<member_t> member(new member_t);
+            member->name = entry.name;
+            member->data.resize(entry.size);
+            if (!file.read((char *)member->data.data(), entry.size))
+            {
+                fail("Truncated zip member");
+                return;
+            }
+
+            if (!emit(std::move(member)))
+                return;
+        }
+    }
+}
\ No newline at end of file
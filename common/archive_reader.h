@@ -0,0 +1,66 @@
+#pragma once
+
+#include "bounded_queue.h"
+
+#include <atomic>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cmn
+{
+    /* sequential reader of tar (ustar, GNU long names, pax paths) and zip (stored members) archives
+    ** members are read ahead by a background thread, so file I/O overlaps decoding and inference
+    ** zip members compressed with any method other than "stored" are skipped with a warning */
+    class archive_reader_t
+    {
+    public:
+        struct member_t
+        {
+            /* path inside the archive, '/' separated */
+            std::string name;
+            std::vector<unsigned char> data;
+        };
+
+        archive_reader_t() {}
+        archive_reader_t(const archive_reader_t &) = delete;
+        archive_reader_t & operator = (const archive_reader_t &) = delete;
+        ~archive_reader_t() { close(); }
+
+        /* by extension: .tar or .zip */
+        static bool is_archive(const std::string & filename);
+
+        /* starts reading ahead up to <prefetch> members */
+        bool open(const std::string & filename, size_t prefetch = 64);
+        void close();
+
+        /* blocks until the next regular file member is read, false at the end of the archive or on error */
+        bool next(member_t & member);
+
+        /* false if reading stopped on a malformed or truncated archive */
+        bool ok() const { return !failed.load(); }
+
+    private:
+        enum FORMAT
+        {
+            TAR,
+            ZIP
+        };
+
+        void read_tar();
+        void read_zip();
+        bool emit(std::unique_ptr<member_t> && member);
+        void fail(const std::string & msg);
+
+        std::string filename;
+        FORMAT format = TAR;
+        // declared before <file>, which must not outlive its buffer
+        std::vector<char> read_buffer;
+        std::ifstream file;
+        std::unique_ptr<bounded_queue_t<std::unique_ptr<member_t>>> queue;
+        std::thread reader;
+        std::atomic<bool> failed{ false };
+    };
+}
\ No newline at end of file
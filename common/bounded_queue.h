@@ -0,0 +1,159 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+
+namespace cmn
+{
+    /* bounded lock-free multi-producer multi-consumer queue (D. Vyukov's ring buffer)
+    ** capacity is rounded up to a power of two
+    ** blocking push / pop spin with backoff, close() wakes them up once the queue is drained */
+    template <typename T>
+    class bounded_queue_t
+    {
+    public:
+        using clock_t = std::chrono::steady_clock;
+
+        explicit bounded_queue_t(size_t capacity)
+        {
+            size_t cap = 2u;
+            while (cap < capacity)
+                cap <<= 1;
+
+            cells.reset(new cell_t[cap]);
+            mask = cap - 1;
+            for (size_t i = 0; i < cap; ++i)
+                cells[i].seq.store(i, std::memory_order_relaxed);
+        }
+        bounded_queue_t(const bounded_queue_t &) = delete;
+        bounded_queue_t & operator = (const bounded_queue_t &) = delete;
+
+        bool try_push(T && item)
+        {
+            size_t pos = enqueue_pos.load(std::memory_order_relaxed);
+            while (true)
+            {
+                cell_t & cell = cells[pos & mask];
+                size_t seq = cell.seq.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+
+                if (diff == 0)
+                {
+                    if (enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        cell.data = std::move(item);
+                        cell.seq.store(pos + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0)
+                    return false; // full
+                else
+                    pos = enqueue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        bool try_pop(T & item)
+        {
+            size_t pos = dequeue_pos.load(std::memory_order_relaxed);
+            while (true)
+            {
+                cell_t & cell = cells[pos & mask];
+                size_t seq = cell.seq.load(std::memory_order_acquire);
+                intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+
+                if (diff == 0)
+                {
+                    if (dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    {
+                        item = std::move(cell.data);
+                        cell.seq.store(pos + mask + 1, std::memory_order_release);
+                        return true;
+                    }
+                }
+                else if (diff < 0)
+                    return false; // empty
+                else
+                    pos = dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
+
+        /* blocks while the queue is full, returns false if the queue is closed */
+        bool push(T && item)
+        {
+            for (size_t spin = 0; !is_closed.load(std::memory_order_acquire); ++spin)
+            {
+                if (try_push(std::move(item)))
+                    return true;
+                backoff(spin);
+            }
+            return false;
+        }
+
+        /* blocks while the queue is empty, returns false once the queue is closed and drained */
+        bool pop(T & item)
+        {
+            return pop_until(item, clock_t::time_point::max());
+        }
+
+        /* as pop(), but also returns false when <deadline> is reached */
+        bool pop_until(T & item, clock_t::time_point deadline)
+        {
+            for (size_t spin = 0; ; ++spin)
+            {
+                if (try_pop(item))
+                    return true;
+
+                // re-check after seeing the close flag: items pushed before close() must not be lost
+                if (is_closed.load(std::memory_order_acquire))
+                    return try_pop(item);
+
+                if (spin >= 16 && clock_t::now() >= deadline)
+                    return false;
+                backoff(spin);
+            }
+        }
+
+        void close() { is_closed.store(true, std::memory_order_release); }
+        bool closed() const { return is_closed.load(std::memory_order_acquire); }
+
+        /* approximate number of items, for monitoring only */
+        size_t size_approx() const
+        {
+            size_t head = dequeue_pos.load(std::memory_order_relaxed);
+            size_t tail = enqueue_pos.load(std::memory_order_relaxed);
+            return tail > head ? tail - head : 0u;
+        }
+
+        size_t capacity() const { return mask + 1; }
+
+    private:
+        static void backoff(size_t spin)
+        {
+            if (spin < 16)
+                return;
+            else if (spin < 64)
+                std::this_thread::yield();
+            else
+                std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+
+        struct cell_t
+        {
+            std::atomic<size_t> seq;
+            T data;
+        };
+
+        std::unique_ptr<cell_t[]> cells;
+        size_t mask = 0;
+
+        alignas(64) std::atomic<size_t> enqueue_pos{ 0 };
+        alignas(64) std::atomic<size_t> dequeue_pos{ 0 };
+        alignas(64) std::atomic<bool> is_closed{ false };
+    };
+}
\ No newline at end of file
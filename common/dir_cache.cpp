@@ -0,0 +1,22 @@
+#include "dir_cache.h"
+
+namespace cmn
+{
+    bool dir_cache_t::create(const path & dir)
+    {
+        std::string key = dir.string();
+
+        std::lock_guard<std::mutex> lg(mutex);
+        if (created.count(key))
+            return true;
+
+        // created by another process or an earlier run is fine as well
+        std::error_code ec;
+        std::experimental::filesystem::v1::create_directories(dir, ec);
+        if (ec && !std::experimental::filesystem::v1::is_directory(dir))
+            return false;
+
+        created.insert(key);
+        return true;
+    }
+}
\ No newline at end of file
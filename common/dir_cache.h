@@ -0,0 +1,28 @@
+#pragma once
+
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_set>
+
+namespace cmn
+{
+    /* creates output directories once, later calls for the same path are a hash lookup
+    ** thread-safe */
+    class dir_cache_t
+    {
+    public:
+        using path = std::experimental::filesystem::v1::path;
+
+        dir_cache_t() {}
+        dir_cache_t(const dir_cache_t &) = delete;
+        dir_cache_t & operator = (const dir_cache_t &) = delete;
+
+        /* creates <dir> with its parents, false if it can't be created */
+        bool create(const path & dir);
+
+    private:
+        std::mutex mutex;
+        std::unordered_set<std::string> created;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace cmn
+{
+    /* XXH64, fast non-cryptographic 64-bit hash */
+    inline uint64_t hash64(const void * data, size_t len, uint64_t seed = 0)
+    {
+        const uint64_t P1 = 11400714785074694791ULL;
+        const uint64_t P2 = 14029467366897019727ULL;
+        const uint64_t P3 = 1609587929392839161ULL;
+        const uint64_t P4 = 9650029242287828579ULL;
+        const uint64_t P5 = 2870177450012600261ULL;
+
+        auto rotl = [](uint64_t x, int r) { return (x << r) | (x >> (64 - r)); };
+        auto read64 = [](const unsigned char * p) { uint64_t v; std::memcpy(&v, p, 8); return v; };
+        auto read32 = [](const unsigned char * p) { uint32_t v; std::memcpy(&v, p, 4); return v; };
+        auto round = [&](uint64_t acc, uint64_t input) { acc += input * P2; acc = rotl(acc, 31); return acc * P1; };
+        auto merge = [&](uint64_t acc, uint64_t val) { acc ^= round(0, val); return acc * P1 + P4; };
+
+        const unsigned char * p = (const unsigned char *)data;
+        const unsigned char * end = p + len;
+        uint64_t h;
+
+        if (len >= 32)
+        {
+            uint64_t v1 = seed + P1 + P2;
+            uint64_t v2 = seed + P2;
+            uint64_t v3 = seed;
+            uint64_t v4 = seed - P1;
+
+            for (; p + 32 <= end; p += 32)
+            {
+                v1 = round(v1, read64(p));
+                v2 = round(v2, read64(p + 8));
+                v3 = round(v3, read64(p + 16));
+                v4 = round(v4, read64(p + 24));
+            }
+
+            h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+            h = merge(h, v1);
+            h = merge(h, v2);
+            h = merge(h, v3);
+            h = merge(h, v4);
+        }
+        else
+            h = seed + P5;
+
+        h += (uint64_t)len;
+
+        for (; p + 8 <= end; p += 8)
+        {
+            h ^= round(0, read64(p));
+            h = rotl(h, 27) * P1 + P4;
+        }
+        if (p + 4 <= end)
+        {
+            h ^= (uint64_t)read32(p) * P1;
+            h = rotl(h, 23) * P2 + P3;
+            p += 4;
+        }
+        for (; p < end; ++p)
+        {
+            h ^= (*p) * P5;
+            h = rotl(h, 11) * P1;
+        }
+
+        h ^= h >> 33;
+        h *= P2;
+        h ^= h >> 29;
+        h *= P3;
+        h ^= h >> 32;
+
+        return h;
+    }
+
+    inline uint64_t hash64(const std::string & str, uint64_t seed = 0)
+    {
+        return hash64(str.data(), str.size(), seed);
+    }
+
+    inline uint64_t hash_combine(uint64_t a, uint64_t b)
+    {
+        return hash64(&b, sizeof(b), a);
+    }
+
+    /* hash of the whole file content, false if the file can't be read */
+    inline bool file_hash(const std::string & filename, uint64_t & hash)
+    {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open())
+            return false;
+
+        std::vector<char> buf((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+        hash = hash64(buf.data(), buf.size());
+        return true;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,176 @@
+#include "image_io.h"
+
+#include <opencv2/imgcodecs.hpp>
+
+#include <algorithm>
+#include <cctype>
+#include <fstream>
+#include <vector>
+
+namespace cmn
+{
+    namespace
+    {
+        enum PARSE_RESULT
+        {
+            FOUND,
+            NOT_FOUND,
+            NEED_MORE
+        };
+
+        PARSE_RESULT parse_jpeg_size(const uchar * data, size_t len, cv::Size & size)
+        {
+            if (len < 2)
+                return NEED_MORE;
+            if (data[0] != 0xFF || data[1] != 0xD8)
+                return NOT_FOUND;
+
+            size_t pos = 2;
+            while (true)
+            {
+                // skip fill bytes
+                while (pos < len && data[pos] == 0xFF && pos + 1 < len && data[pos + 1] == 0xFF)
+                    ++pos;
+                if (pos + 4 > len)
+                    return NEED_MORE;
+                if (data[pos] != 0xFF)
+                    return NOT_FOUND;
+
+                uchar marker = data[pos + 1];
+                // standalone markers have no length field
+                if (marker == 0x01 || (marker >= 0xD0 && marker <= 0xD8))
+                {
+                    pos += 2;
+                    continue;
+                }
+                // EOI / SOS before any frame header
+                if (marker == 0xD9 || marker == 0xDA)
+                    return NOT_FOUND;
+
+                size_t seg_len = ((size_t)data[pos + 2] << 8) | data[pos + 3];
+                if (seg_len < 2)
+                    return NOT_FOUND;
+
+                // SOF0..SOF15, except DHT, JPG and DAC
+                if (marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC)
+                {
+                    if (pos + 9 > len)
+                        return NEED_MORE;
+
+                    int height = (data[pos + 5] << 8) | data[pos + 6];
+                    int width = (data[pos + 7] << 8) | data[pos + 8];
+                    size = cv::Size(width, height);
+                    return (width > 0 && height > 0) ? FOUND : NOT_FOUND;
+                }
+
+                pos += 2 + seg_len;
+            }
+        }
+    }
+
+    bool jpeg_size(const uchar * data, size_t len, cv::Size & size)
+    {
+        return parse_jpeg_size(data, len, size) == FOUND;
+    }
+
+    bool jpeg_size(const std::string & filename, cv::Size & size)
+    {
+        std::ifstream file(filename, std::ios::binary);
+        if (!file.is_open())
+            return false;
+
+        // headers are usually within the first few KB, large EXIF / ICC blocks need more
+        std::vector<uchar> head;
+        for (size_t chunk = 16u << 10; chunk <= (4u << 20); chunk *= 4)
+        {
+            size_t read = head.size();
+            head.resize(chunk);
+            file.read((char *)head.data() + read, (std::streamsize)(chunk - read));
+            head.resize(read + (size_t)file.gcount());
+
+            PARSE_RESULT res = parse_jpeg_size(head.data(), head.size(), size);
+            if (res != NEED_MORE || !file)
+                return res == FOUND;
+        }
+
+        return false;
+    }
+
+    int reduce_factor(const cv::Size & src, const cv::Size & min_size)
+    {
+        int src_side = std::min(src.width, src.height);
+        int dst_side = std::max(min_size.width, min_size.height);
+
+        for (int factor = 8; factor > 1; factor /= 2)
+            if (src_side / factor >= dst_side)
+                return factor;
+
+        return 1;
+    }
+
+    int reduced_imread_flag(int factor)
+    {
+        switch (factor)
+        {
+        case 2:
+            return cv::IMREAD_REDUCED_COLOR_2;
+        case 4:
+            return cv::IMREAD_REDUCED_COLOR_4;
+        case 8:
+            return cv::IMREAD_REDUCED_COLOR_8;
+        default:
+            return cv::IMREAD_COLOR;
+        }
+    }
+
+    cv::Mat imread_reduced(const std::string & filename, const cv::Size & min_size, int & factor)
+    {
+        cv::Size size;
+        factor = jpeg_size(filename, size) ? reduce_factor(size, min_size) : 1;
+
+        return cv::imread(filename, reduced_imread_flag(factor));
+    }
+
+    cv::Mat imdecode_reduced(const std::vector<uchar> & buf, const cv::Size & min_size, int & factor)
+    {
+        cv::Size size;
+        factor = jpeg_size(buf.data(), buf.size(), size) ? reduce_factor(size, min_size) : 1;
+
+        return cv::imdecode(buf, reduced_imread_flag(factor));
+    }
+
+    bool read_file(const std::string & filename, std::vector<uchar> & buf)
+    {
+        std::ifstream file(filename, std::ios::binary | std::ios::ate);
+        if (!file.is_open())
+            return false;
+
+        std::streamsize size = file.tellg();
+        file.seekg(0, std::ios::beg);
+
+        buf.resize((size_t)size);
+        return (bool)file.read((char *)buf.data(), size);
+    }
+
+    bool write_file(const std::string & filename, const std::vector<uchar> & buf)
+    {
+        std::ofstream file(filename, std::ios::binary | std::ios::trunc);
+        if (!file.is_open())
+            return false;
+
+        return (bool)file.write((const char *)buf.data(), (std::streamsize)buf.size());
+    }
+
+    std::string lower_ext(const std::string & filename)
+    {
+        size_t slash = filename.find_last_of("/\\");
+        size_t stem = (slash == std::string::npos ? 0 : slash + 1);
+        size_t dot = filename.find_last_of('.');
+        if (dot == std::string::npos || dot <= stem)
+            return std::string();
+
+        std::string ext = filename.substr(dot);
+        std::transform(ext.begin(), ext.end(), ext.begin(), [](unsigned char c) { return (char)std::tolower(c); });
+        return ext;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <string>
+#include <vector>
+
+namespace cmn
+{
+    /* reads image size from the JPEG SOFn marker without decoding
+    ** returns false for non-JPEG or truncated data */
+    bool jpeg_size(const uchar * data, size_t len, cv::Size & size);
+    bool jpeg_size(const std::string & filename, cv::Size & size);
+
+    /* largest of 1, 2, 4, 8 such that <src> downscaled by it still covers <min_size>
+    ** orientation-agnostic, since the decoder applies EXIF rotation after the size is known */
+    int reduce_factor(const cv::Size & src, const cv::Size & min_size);
+
+    /* cv::IMREAD_COLOR or cv::IMREAD_REDUCED_COLOR_{2,4,8} for the given factor */
+    int reduced_imread_flag(int factor);
+
+    /* JPEGs are decoded at the largest reduce_factor() covering <min_size>, other formats at full resolution
+    ** <factor> is set to the applied downscale factor (1 - full resolution) */
+    cv::Mat imread_reduced(const std::string & filename, const cv::Size & min_size, int & factor);
+    cv::Mat imdecode_reduced(const std::vector<uchar> & buf, const cv::Size & min_size, int & factor);
+
+    bool read_file(const std::string & filename, std::vector<uchar> & buf);
+    bool write_file(const std::string & filename, const std::vector<uchar> & buf);
+
+    /* lowercase extension with the leading dot as in path::extension(), empty for none and for dotfiles */
+    std::string lower_ext(const std::string & filename);
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#include "label_index.h"
+#include "hash.h"
+
+namespace cmn
+{
+    void label_index_t::build(const std::vector<std::string> & labels)
+    {
+        arena.clear();
+        num_labels = labels.size();
+
+        // load factor <= 0.5 keeps probe chains short
+        size_t capacity = 16;
+        while (capacity < 2 * labels.size())
+            capacity *= 2;
+        slots.assign(capacity, slot_t());
+        mask = capacity - 1;
+
+        size_t total_length = 0;
+        for (const auto & label : labels)
+            total_length += label.size();
+        arena.reserve(total_length);
+
+        for (size_t i = 0; i < labels.size(); ++i)
+        {
+            const std::string & label = labels[i];
+            if (find(label) >= 0)
+                continue;
+
+            uint64_t hash = hash64(label);
+            size_t pos = hash & mask;
+            while (slots[pos].idx >= 0)
+                pos = (pos + 1) & mask;
+
+            slots[pos].hash = hash;
+            slots[pos].offset = (uint32_t)arena.size();
+            slots[pos].length = (uint32_t)label.size();
+            slots[pos].idx = (int32_t)i;
+            arena += label;
+        }
+    }
+
+    int label_index_t::find(std::string_view label) const
+    {
+        if (slots.empty())
+            return -1;
+
+        uint64_t hash = hash64(label.data(), label.size());
+        for (size_t pos = hash & mask; slots[pos].idx >= 0; pos = (pos + 1) & mask)
+        {
+            const slot_t & slot = slots[pos];
+            if (slot.hash == hash && std::string_view(arena.data() + slot.offset, slot.length) == label)
+                return slot.idx;
+        }
+
+        return -1;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace cmn
+{
+    /* label -> position in the label list, open addressing with linear probing
+    ** labels are copied into a single arena, lookups by std::string_view don't allocate
+    ** duplicate labels resolve to the first occurrence */
+    class label_index_t
+    {
+    public:
+        label_index_t() {};
+
+        void build(const std::vector<std::string> & labels);
+
+        /* -1 if not found */
+        int find(std::string_view label) const;
+
+        inline size_t size() const { return num_labels; }
+
+    private:
+        struct slot_t
+        {
+            uint64_t hash = 0;
+            uint32_t offset = 0;
+            uint32_t length = 0;
+            int32_t idx = -1;
+        };
+
+        std::string arena;
+        std::vector<slot_t> slots;
+        size_t mask = 0;
+        size_t num_labels = 0;
+    };
+}
\ No newline at end of file
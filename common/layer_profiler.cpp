@@ -0,0 +1,107 @@
+#include "layer_profiler.h"
+
+#include <logger.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <numeric>
+
+namespace cmn
+{
+    void layer_profiler_t::init(size_t warmup)
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+        on = true;
+        this->warmup = warmup;
+        seen.clear();
+        inputs = 0;
+        layers.clear();
+        total = latency_histogram_t();
+    }
+
+    void layer_profiler_t::add(cv::dnn::Net & net, size_t replica, size_t inputs)
+    {
+        // timings of the last forward pass of this replica
+        thread_local std::vector<double> timings;
+        int64_t ticks = net.getPerfProfile(timings);
+        double tick_ns = 1e9 / cv::getTickFrequency();
+
+        std::lock_guard<std::mutex> lg(mtx);
+        if (replica >= seen.size())
+            seen.resize(replica + 1, 0u);
+        seen[replica] += inputs;
+        if (seen[replica] <= warmup)
+            return;
+
+        if (layers.empty())
+            layers.resize(timings.size());
+        if (layers.size() != timings.size())
+            return;
+
+        for (size_t i = 0; i < timings.size(); ++i)
+            layers[i].record((uint64_t)std::max(timings[i] * tick_ns, 0.));
+        total.record((uint64_t)std::max(ticks * tick_ns, 0.));
+        this->inputs += inputs;
+    }
+
+    void layer_profiler_t::print(cv::dnn::Net & net, const std::vector<int> & input_shape, const std::string & title) const
+    {
+        std::lock_guard<std::mutex> lg(mtx);
+
+        if (!total.count())
+        {
+            logger::LOG_MSG(logger::LOG_LEVEL_t::Warning, "Layer profile of " + title + " is empty, fewer network inputs than warm-up ones.");
+            return;
+        }
+
+        std::vector<cv::String> names = net.getLayerNames();
+        if (names.size() != layers.size())
+        {
+            logger::LOG_MSG(logger::LOG_LEVEL_t::Warning, "Layer profile of " + title + " doesn't match the network layers.");
+            return;
+        }
+
+        uint64_t layers_ns = 0;
+        for (const auto & l : layers)
+            layers_ns += l.sum();
+
+        // hot spots first, the index keeps the network order
+        std::vector<size_t> order(layers.size());
+        std::iota(order.begin(), order.end(), 0u);
+        std::stable_sort(order.begin(), order.end(), [&](size_t l, size_t r) { return layers[l].sum() > layers[r].sum(); });
+
+        char line[512];
+        std::string table = "Layer profile of " + title + ", ms per forward pass:\n";
+        std::snprintf(line, sizeof(line), "%llu forward passes, %llu inputs (%.1f per pass), forward %.3f ms mean, %.3f ms p95\n",
+            (unsigned long long)total.count(), (unsigned long long)inputs, 1. * inputs / total.count(),
+            total.sum() / 1e6 / total.count(), total.percentile(0.95) / 1e6);
+        table += line;
+        std::snprintf(line, sizeof(line), "%5s %-40s %-16s %9s %9s %9s %9s %9s %7s %10s\n",
+            "id", "layer", "type", "mean", "p50", "p95", "p99", "per input", "share", "MFLOPs");
+        table += line;
+
+        for (size_t i : order)
+        {
+            const auto & h = layers[i];
+            int id = net.getLayerId(names[i]);
+            cv::Ptr<cv::dnn::Layer> layer = net.getLayer(id);
+            double mflops = net.getFLOPS(id, input_shape) / 1e6;
+
+            std::snprintf(line, sizeof(line), "%5d %-40s %-16s %9.3f %9.3f %9.3f %9.3f %9.3f %6.2f%% %10.1f\n",
+                id, names[i].c_str(), layer ? layer->type.c_str() : "",
+                h.sum() / 1e6 / h.count(), h.percentile(0.5) / 1e6, h.percentile(0.95) / 1e6, h.percentile(0.99) / 1e6,
+                h.sum() / 1e6 / inputs, layers_ns ? 100. * h.sum() / layers_ns : 0., mflops);
+            table += line;
+        }
+
+        size_t weights = 0;
+        size_t blobs = 0;
+        net.getMemoryConsumption(input_shape, weights, blobs);
+        std::snprintf(line, sizeof(line), "Total: %.1f MFLOPs, weights %.1f MB, blobs %.1f MB per input of [%s]",
+            net.getFLOPS(input_shape) / 1e6, weights / 1048576., blobs / 1048576.,
+            std::accumulate(input_shape.begin(), input_shape.end(), std::string(), [](const std::string & s, int d) { return s.empty() ? std::to_string(d) : s + 'x' + std::to_string(d); }).c_str());
+        table += line;
+
+        logger::LOG_MSG(logger::LOG_LEVEL_t::Info, table);
+    }
+}
\ No newline at end of file
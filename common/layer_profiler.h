@@ -0,0 +1,42 @@
+#pragma once
+
+#include "stage_timers.h"
+
+#include <opencv2/dnn.hpp>
+
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cmn
+{
+    /* per-layer forward times from cv::dnn::Net::getPerfProfile(), collected over every replica
+    ** once <warmup> network inputs have passed through it, so lazy allocations and cold caches are not measured */
+    class layer_profiler_t
+    {
+    public:
+        layer_profiler_t() {}
+        layer_profiler_t(const layer_profiler_t &) = delete;
+        layer_profiler_t & operator = (const layer_profiler_t &) = delete;
+
+        void init(size_t warmup);
+        bool enabled() const { return on; }
+
+        /* right after a forward pass of replica <replica> over <inputs> network inputs, while it is still leased */
+        void add(cv::dnn::Net & net, size_t replica, size_t inputs);
+
+        /* per-layer table sorted by time share, with FLOPs and memory for a single input of <input_shape> */
+        void print(cv::dnn::Net & net, const std::vector<int> & input_shape, const std::string & title) const;
+
+    private:
+        bool on = false;
+        size_t warmup = 0;
+
+        mutable std::mutex mtx;
+        /* network inputs per replica, including warm-up ones */
+        std::vector<size_t> seen;
+        size_t inputs = 0;
+        std::vector<latency_histogram_t> layers;
+        latency_histogram_t total;
+    };
+}
\ No newline at end of file
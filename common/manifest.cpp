@@ -0,0 +1,361 @@
+#include "manifest.h"
+#include "image_io.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <unordered_map>
+
+namespace cmn
+{
+    namespace
+    {
+        namespace fs = std::experimental::filesystem::v1;
+
+        const char MAGIC[8] = { 'C', 'N', 'N', 'T', 'M', 'F', '0', '2' };
+        const size_t WRITE_BUFFER_SIZE = 1 << 20;
+
+        /* bounds-checked reader over the mapped manifest */
+        struct cursor_t
+        {
+            const unsigned char * p;
+            const unsigned char * end;
+            bool ok = true;
+
+            template <typename T>
+            T get()
+            {
+                T v = T();
+                if (!ok || (size_t)(end - p) < sizeof(T))
+                {
+                    ok = false;
+                    return v;
+                }
+                std::memcpy(&v, p, sizeof(T));
+                p += sizeof(T);
+                return v;
+            }
+
+            void get(std::string & str)
+            {
+                uint32_t len = get<uint32_t>();
+                if (!ok || (size_t)(end - p) < len)
+                {
+                    ok = false;
+                    return;
+                }
+                str.assign((const char *)p, len);
+                p += len;
+            }
+
+            bool at_end() const { return p == end; }
+        };
+
+        template <typename T>
+        void put(std::ostream & out, T v)
+        {
+            out.write((const char *)&v, sizeof(T));
+        }
+
+        void put(std::ostream & out, const std::string & str)
+        {
+            put<uint32_t>(out, (uint32_t)str.size());
+            out.write(str.data(), (std::streamsize)str.size());
+        }
+
+        struct header_t
+        {
+            uint64_t labels_key = 0;
+            uint32_t num_labels = 0;
+            bool check_subdirs = true;
+            uint32_t max_subdir_depth = 0;
+            std::vector<std::string> ext_list;
+        };
+
+        bool read_header(cursor_t & c, header_t & header)
+        {
+            if ((size_t)(c.end - c.p) < sizeof(MAGIC) || std::memcmp(c.p, MAGIC, sizeof(MAGIC)) != 0)
+                return false;
+            c.p += sizeof(MAGIC);
+
+            header.labels_key = c.get<uint64_t>();
+            header.num_labels = c.get<uint32_t>();
+            header.check_subdirs = c.get<uint8_t>() != 0;
+            header.max_subdir_depth = c.get<uint32_t>();
+            header.ext_list.resize(c.get<uint32_t>());
+            for (size_t i = 0; c.ok && i < header.ext_list.size(); ++i)
+                c.get(header.ext_list[i]);
+            return c.ok;
+        }
+
+        /* the listing depends on these, unlike on labels which can be dropped at read time */
+        bool scan_matches(const header_t & header, const manifest_t::settings_t & settings)
+        {
+            std::vector<std::string> stored = header.ext_list;
+            std::vector<std::string> current = settings.ext_list;
+            std::sort(stored.begin(), stored.end());
+            std::sort(current.begin(), current.end());
+
+            return header.check_subdirs == settings.check_subdirs &&
+                header.max_subdir_depth == settings.max_subdir_depth &&
+                stored == current;
+        }
+
+        void read_file(cursor_t & c, std::string & name, manifest_t::entry_t & entry, uint32_t num_labels)
+        {
+            c.get(name);
+            entry.size = c.get<uint64_t>();
+            entry.mtime = c.get<int64_t>();
+            entry.labels_ok = c.get<uint8_t>() != 0;
+            entry.labels.resize(num_labels);
+            for (uint32_t i = 0; i < num_labels; ++i)
+                entry.labels[i] = c.get<int32_t>();
+        }
+
+        void write_file(std::ostream & out, const std::string & name, const manifest_t::entry_t & entry)
+        {
+            put(out, name);
+            put<uint64_t>(out, entry.size);
+            put<int64_t>(out, entry.mtime);
+            put<uint8_t>(out, entry.labels_ok ? 1 : 0);
+            for (int label : entry.labels)
+                put<int32_t>(out, label);
+        }
+
+        int64_t mtime_of(const fs::path & p, std::error_code & ec)
+        {
+            auto t = fs::last_write_time(p, ec);
+            return ec ? 0 : (int64_t)t.time_since_epoch().count();
+        }
+
+        /* directory record of a previous manifest */
+        struct old_dir_t
+        {
+            int64_t mtime;
+            const unsigned char * begin;
+            const unsigned char * files;
+            const unsigned char * end;
+            uint32_t num_files;
+        };
+    }
+
+    bool manifest_t::build(const path & root, const settings_t & settings, const std::string & filename, bool incremental)
+    {
+        // previous manifest: raw records of unchanged directories are copied as is
+        mapped_file_t old;
+        std::unordered_map<std::string, old_dir_t> old_dirs;
+        std::unordered_map<std::string, std::vector<std::string>> old_children;
+        bool reuse = false;
+
+        if (incremental && fs::exists(filename) && old.open(filename) && old.data())
+        {
+            cursor_t c{ old.data(), old.data() + old.size() };
+            header_t header;
+            reuse = read_header(c, header) && scan_matches(header, settings) &&
+                header.labels_key == settings.labels_key && header.num_labels == settings.num_labels;
+
+            std::string rel, name;
+            entry_t entry;
+            while (reuse && !c.at_end())
+            {
+                old_dir_t dir;
+                dir.begin = c.p;
+                c.get(rel);
+                dir.mtime = c.get<int64_t>();
+                dir.num_files = c.get<uint32_t>();
+                dir.files = c.p;
+                for (uint32_t i = 0; c.ok && i < dir.num_files; ++i)
+                    read_file(c, name, entry, header.num_labels);
+                dir.end = c.p;
+
+                // a truncated manifest is rebuilt from scratch
+                reuse = c.ok;
+                if (!rel.empty())
+                {
+                    size_t slash = rel.find_last_of('/');
+                    old_children[slash == std::string::npos ? std::string() : rel.substr(0, slash)].push_back(rel);
+                }
+                old_dirs[rel] = dir;
+            }
+
+            if (!reuse)
+            {
+                old_dirs.clear();
+                old_children.clear();
+            }
+        }
+
+        std::string tmp = filename + ".tmp";
+        std::vector<char> write_buffer(WRITE_BUFFER_SIZE);
+        std::ofstream out;
+        out.rdbuf()->pubsetbuf(write_buffer.data(), (std::streamsize)write_buffer.size());
+        out.open(tmp, std::ios::binary | std::ios::trunc);
+        if (!out.is_open())
+            return false;
+
+        out.write(MAGIC, sizeof(MAGIC));
+        put<uint64_t>(out, settings.labels_key);
+        put<uint32_t>(out, (uint32_t)settings.num_labels);
+        put<uint8_t>(out, settings.check_subdirs ? 1 : 0);
+        put<uint32_t>(out, (uint32_t)settings.max_subdir_depth);
+        put<uint32_t>(out, (uint32_t)settings.ext_list.size());
+        for (const auto & ext : settings.ext_list)
+            put(out, ext);
+
+        // depth-first in name order, the same order as read() streams it
+        std::vector<std::pair<std::string, size_t>> stack = { { std::string(), 0u } };
+        std::vector<std::string> subdirs;
+        std::vector<std::pair<std::string, entry_t>> files;
+        std::unordered_map<std::string, entry_t> old_files;
+        std::string name;
+
+        while (!stack.empty())
+        {
+            std::string rel = stack.back().first;
+            size_t depth = stack.back().second;
+            stack.pop_back();
+
+            path dir = rel.empty() ? root : root / rel;
+            std::error_code ec;
+            int64_t mtime = mtime_of(dir, ec);
+            if (ec)
+                continue;
+
+            subdirs.clear();
+            auto old_dir = old_dirs.find(rel);
+            if (old_dir != old_dirs.end() && old_dir->second.mtime == mtime)
+            {
+                out.write((const char *)old_dir->second.begin, old_dir->second.end - old_dir->second.begin);
+                auto children = old_children.find(rel);
+                if (children != old_children.end())
+                    subdirs = children->second;
+            }
+            else
+            {
+                // listing changed, files seen before keep their labels if size and mtime match
+                old_files.clear();
+                if (old_dir != old_dirs.end())
+                {
+                    cursor_t c{ old_dir->second.files, old_dir->second.end };
+                    for (uint32_t i = 0; i < old_dir->second.num_files; ++i)
+                    {
+                        entry_t entry;
+                        read_file(c, name, entry, (uint32_t)settings.num_labels);
+                        old_files[name] = entry;
+                    }
+                }
+
+                files.clear();
+                for (fs::directory_iterator it(dir, ec), last; !ec && it != last; it.increment(ec))
+                {
+                    const path & p = it->path();
+                    name = p.filename().string();
+
+                    if (fs::is_directory(it->status()))
+                    {
+                        subdirs.push_back(rel.empty() ? name : rel + '/' + name);
+                        continue;
+                    }
+
+                    if (!fs::is_regular_file(it->status()) ||
+                        std::find(settings.ext_list.begin(), settings.ext_list.end(), lower_ext(p.string())) == settings.ext_list.end())
+                        continue;
+
+                    std::error_code file_ec;
+                    entry_t entry;
+                    entry.size = (uint64_t)fs::file_size(p, file_ec);
+                    entry.mtime = mtime_of(p, file_ec);
+                    if (file_ec)
+                        continue;
+
+                    auto old_file = old_files.find(name);
+                    if (old_file != old_files.end() && old_file->second.size == entry.size && old_file->second.mtime == entry.mtime)
+                        entry = old_file->second;
+                    else
+                    {
+                        entry.labels.assign(settings.num_labels, -1);
+                        entry.labels_ok = settings.labeler && settings.labeler(name, entry.labels);
+                        entry.labels.resize(settings.num_labels, -1);
+                    }
+
+                    files.emplace_back(name, std::move(entry));
+                }
+                std::sort(files.begin(), files.end(), [](const std::pair<std::string, entry_t> & l, const std::pair<std::string, entry_t> & r) { return l.first < r.first; });
+
+                put(out, rel);
+                put<int64_t>(out, mtime);
+                put<uint32_t>(out, (uint32_t)files.size());
+                for (const auto & file : files)
+                    write_file(out, file.first, file.second);
+            }
+
+            if (settings.check_subdirs && (settings.max_subdir_depth == 0 || depth < settings.max_subdir_depth))
+            {
+                std::sort(subdirs.rbegin(), subdirs.rend());
+                for (const auto & subdir : subdirs)
+                    stack.emplace_back(subdir, depth + 1);
+            }
+        }
+
+        out.close();
+        old.close();
+        if (!out)
+            return false;
+
+        std::error_code ec;
+        fs::rename(tmp, filename, ec);
+        return !ec;
+    }
+
+    bool manifest_t::same_scan(const std::string & filename, const settings_t & settings)
+    {
+        mapped_file_t mapped;
+        if (!mapped.open(filename) || !mapped.data())
+            return false;
+
+        cursor_t c{ mapped.data(), mapped.data() + mapped.size() };
+        header_t header;
+        return read_header(c, header) && scan_matches(header, settings);
+    }
+
+    bool manifest_t::read(const std::string & filename, const path & root, uint64_t labels_key, const visit_func_t & visit)
+    {
+        mapped_file_t mapped;
+        if (!mapped.open(filename) || !mapped.data())
+            return false;
+
+        cursor_t c{ mapped.data(), mapped.data() + mapped.size() };
+        header_t header;
+        if (!read_header(c, header))
+            return false;
+
+        uint32_t num_labels = header.num_labels;
+        bool keep_labels = header.labels_key == labels_key;
+
+        std::string rel, name;
+        entry_t entry;
+        while (c.ok && !c.at_end())
+        {
+            c.get(rel);
+            c.get<int64_t>();
+            uint32_t num_files = c.get<uint32_t>();
+
+            path dir = rel.empty() ? root : root / rel;
+            for (uint32_t i = 0; c.ok && i < num_files; ++i)
+            {
+                read_file(c, name, entry, num_labels);
+                if (!c.ok)
+                    break;
+
+                if (!keep_labels)
+                {
+                    entry.labels_ok = false;
+                    entry.labels.clear();
+                }
+                visit(dir / name, entry);
+            }
+        }
+
+        return c.ok;
+    }
+}
\ No newline at end of file
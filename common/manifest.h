@@ -0,0 +1,61 @@
+#pragma once
+
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <filesystem>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace cmn
+{
+    /* compact binary listing of an input tree, streamed instead of crawling it
+    ** "CNNTMF02" | u64 labels_key | u32 num_labels | u8 check_subdirs | u32 max_subdir_depth | u32 num_ext | num_ext * (u32 len | ext),
+    ** then a record per directory:
+    ** u32 len | relative dir ('/' separated) | i64 mtime | u32 num_files | num_files * file
+    ** file: u32 len | name | u64 size | i64 mtime | u8 labels_ok | i32 labels[num_labels]
+    ** every crawled directory has a record, including ones without matching files, so a refresh
+    ** re-lists only directories whose mtime changed (files modified in place keep their old size / mtime) */
+    class manifest_t
+    {
+    public:
+        using path = std::experimental::filesystem::v1::path;
+
+        struct entry_t
+        {
+            uint64_t size = 0;
+            int64_t mtime = 0;
+            /* ground truth parsed at build time, valid only if <labels_ok> */
+            bool labels_ok = false;
+            std::vector<int> labels;
+        };
+
+        /* parses ground truth of a file name, false if it has none */
+        using label_func_t = std::function<bool(const std::string & filename_short, std::vector<int> & labels)>;
+        using visit_func_t = std::function<void(const path & file, const entry_t & entry)>;
+
+        struct settings_t
+        {
+            std::vector<std::string> ext_list;
+            bool check_subdirs = true;
+            /* 0 - any depth */
+            size_t max_subdir_depth = 0;
+
+            size_t num_labels = 0;
+            /* identity of the label set, stored labels are ignored if it changes */
+            uint64_t labels_key = 0;
+            label_func_t labeler;
+        };
+
+        /* crawls <root> into <filename>, with <incremental> an existing manifest is reused for unchanged directories
+        ** if it was crawled with the same scan settings and labels, otherwise it is rebuilt from scratch */
+        static bool build(const path & root, const settings_t & settings, const std::string & filename, bool incremental);
+
+        /* <filename> is a readable manifest crawled with the same extensions and subdirectory settings */
+        static bool same_scan(const std::string & filename, const settings_t & settings);
+
+        /* streams entries in crawl order, labels are dropped if <labels_key> differs from the stored one */
+        static bool read(const std::string & filename, const path & root, uint64_t labels_key, const visit_func_t & visit);
+    };
+}
\ No newline at end of file
@@ -0,0 +1,110 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#   define NOMINMAX
+#   include <windows.h>
+#else
+#   include <fcntl.h>
+#   include <sys/mman.h>
+#   include <sys/stat.h>
+#   include <unistd.h>
+#endif // _WIN32
+
+namespace cmn
+{
+#ifdef _WIN32
+    bool mapped_file_t::open(const std::string & filename)
+    {
+        close();
+
+        HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (file == INVALID_HANDLE_VALUE)
+            return false;
+
+        LARGE_INTEGER file_size;
+        if (!GetFileSizeEx(file, &file_size))
+        {
+            CloseHandle(file);
+            return false;
+        }
+
+        file_handle = file;
+        len = (size_t)file_size.QuadPart;
+        if (len == 0)
+            return true;
+
+        map_handle = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if (map_handle)
+            ptr = (const unsigned char *)MapViewOfFile(map_handle, FILE_MAP_READ, 0, 0, 0);
+
+        if (!ptr)
+        {
+            close();
+            return false;
+        }
+
+        return true;
+    }
+
+    void mapped_file_t::close()
+    {
+        if (ptr)
+            UnmapViewOfFile(ptr);
+        if (map_handle)
+            CloseHandle(map_handle);
+        if (file_handle)
+            CloseHandle(file_handle);
+
+        ptr = nullptr;
+        map_handle = nullptr;
+        file_handle = nullptr;
+        len = 0;
+    }
+#else
+    bool mapped_file_t::open(const std::string & filename)
+    {
+        close();
+
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0)
+            return false;
+
+        struct stat st;
+        if (fstat(fd, &st) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+
+        len = (size_t)st.st_size;
+        if (len == 0)
+        {
+            ::close(fd);
+            return true;
+        }
+
+        void * mem = mmap(nullptr, len, PROT_READ, MAP_SHARED, fd, 0);
+        ::close(fd);
+
+        if (mem == MAP_FAILED)
+        {
+            len = 0;
+            return false;
+        }
+
+        // records are mostly read in file order
+        madvise(mem, len, MADV_SEQUENTIAL);
+        ptr = (const unsigned char *)mem;
+        return true;
+    }
+
+    void mapped_file_t::close()
+    {
+        if (ptr)
+            munmap((void *)ptr, len);
+
+        ptr = nullptr;
+        len = 0;
+    }
+#endif // _WIN32
+}
\ No newline at end of file
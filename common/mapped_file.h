@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace cmn
+{
+    /* read-only memory-mapped file */
+    class mapped_file_t
+    {
+    public:
+        mapped_file_t() {}
+        mapped_file_t(const mapped_file_t &) = delete;
+        mapped_file_t & operator = (const mapped_file_t &) = delete;
+        ~mapped_file_t() { close(); }
+
+        /* an empty file is opened successfully with data() == nullptr */
+        bool open(const std::string & filename);
+        void close();
+
+        const unsigned char * data() const { return ptr; }
+        size_t size() const { return len; }
+
+    private:
+        const unsigned char * ptr = nullptr;
+        size_t len = 0;
+#   ifdef _WIN32
+        void * file_handle = nullptr;
+        void * map_handle = nullptr;
+#   endif // _WIN32
+    };
+}
\ No newline at end of file
@@ -0,0 +1,113 @@
+#include "net_pool.h"
+#include "image_io.h"
+
+#include <algorithm>
+
+namespace cmn
+{
+    namespace
+    {
+        /* framework name as accepted by cv::dnn::readNet() and whether the file holds the network config (text part) */
+        bool framework_of(const std::string & filename, std::string & framework, bool & is_config)
+        {
+            const std::string ext = lower_ext(filename);
+
+            is_config = (ext == ".prototxt" || ext == ".pbtxt" || ext == ".cfg" || ext == ".xml");
+            if (ext == ".caffemodel" || ext == ".prototxt")
+                framework = "caffe";
+            else if (ext == ".pb" || ext == ".pbtxt")
+                framework = "tensorflow";
+            else if (ext == ".weights" || ext == ".cfg")
+                framework = "darknet";
+            else if (ext == ".bin" || ext == ".xml")
+                framework = "dldt";
+            else if (ext == ".onnx")
+                framework = "onnx";
+            else
+                return false;
+
+            return true;
+        }
+    }
+
+    bool net_pool_t::load(const std::string & model, const std::string & weights, size_t replicas, int backend, int target)
+    {
+        nets.clear();
+        free_idx.clear();
+
+        std::string model_fw, weights_fw;
+        bool model_is_config = false, weights_is_config = false;
+        bool from_buffer = framework_of(model, model_fw, model_is_config) &&
+            (weights.empty() || (framework_of(weights, weights_fw, weights_is_config) && weights_fw == model_fw));
+
+        /* files are read once, replicas are parsed from memory */
+        std::vector<uchar> buf_model, buf_config;
+        if (from_buffer)
+        {
+            const std::string & config_file = model_is_config ? model : weights;
+            const std::string & model_file = model_is_config ? weights : model;
+
+            if (!read_file(model_file, buf_model) || (!config_file.empty() && !read_file(config_file, buf_config)))
+                return false;
+        }
+
+        for (size_t i = 0; i < std::max<size_t>(replicas, 1u); ++i)
+        {
+            cv::dnn::Net net = from_buffer ?
+                cv::dnn::readNet(model_fw, buf_model, buf_config) :
+                cv::dnn::readNet(model, weights);
+
+            if (net.empty())
+                return false;
+
+            net.setPreferableBackend(backend);
+            net.setPreferableTarget(target);
+
+            nets.push_back(net);
+            free_idx.push_back(i);
+        }
+
+        return true;
+    }
+
+    bool net_pool_t::load(const std::function<cv::dnn::Net()> & factory, size_t replicas, int backend, int target)
+    {
+        nets.clear();
+        free_idx.clear();
+
+        for (size_t i = 0; i < std::max<size_t>(replicas, 1u); ++i)
+        {
+            cv::dnn::Net net = factory();
+            if (net.empty())
+                return false;
+
+            net.setPreferableBackend(backend);
+            net.setPreferableTarget(target);
+
+            nets.push_back(net);
+            free_idx.push_back(i);
+        }
+
+        return true;
+    }
+
+    net_pool_t::lease_t net_pool_t::acquire()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        cv_free.wait(lock, [this]() { return !free_idx.empty(); });
+
+        size_t idx = free_idx.back();
+        free_idx.pop_back();
+
+        return lease_t(*this, idx);
+    }
+
+    void net_pool_t::release(size_t idx)
+    {
+        {
+            std::lock_guard<std::mutex> lg(mtx);
+            free_idx.push_back(idx);
+        }
+        cv_free.notify_one();
+    }
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <opencv2/dnn.hpp>
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cmn
+{
+    /* pool of independent cv::dnn::Net replicas loaded from the same model / weights
+    ** cv::dnn::Net is not thread-safe, so every inference call checks out its own replica */
+    class net_pool_t
+    {
+    public:
+        class lease_t
+        {
+        public:
+            lease_t(net_pool_t & pool, size_t idx)
+                : pool(&pool)
+                , idx(idx) {}
+            lease_t(lease_t && other)
+                : pool(other.pool)
+                , idx(other.idx) { other.pool = nullptr; }
+            lease_t(const lease_t &) = delete;
+            lease_t & operator = (const lease_t &) = delete;
+            ~lease_t() { if (pool) pool->release(idx); }
+
+            cv::dnn::Net & net() const { return pool->nets[idx]; }
+            size_t id() const { return idx; }
+
+        private:
+            net_pool_t * pool;
+            size_t idx;
+        };
+
+        net_pool_t() {}
+        net_pool_t(const net_pool_t &) = delete;
+        net_pool_t & operator = (const net_pool_t &) = delete;
+
+        bool load(const std::string & model, const std::string & weights, size_t replicas,
+            int backend = cv::dnn::DNN_BACKEND_DEFAULT, int target = cv::dnn::DNN_TARGET_CPU);
+        /* replicas built by <factory>, e.g. networks assembled in code */
+        bool load(const std::function<cv::dnn::Net()> & factory, size_t replicas,
+            int backend = cv::dnn::DNN_BACKEND_DEFAULT, int target = cv::dnn::DNN_TARGET_CPU);
+
+        /* blocks until a replica is free */
+        lease_t acquire();
+
+        size_t size() const { return nets.size(); }
+        bool empty() const { return nets.empty(); }
+
+    private:
+        void release(size_t idx);
+
+        std::vector<cv::dnn::Net> nets;
+        std::vector<size_t> free_idx;
+        std::mutex mtx;
+        std::condition_variable cv_free;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,197 @@
+#pragma once
+
+#include "bounded_queue.h"
+
+#include <logger.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace cmn
+{
+    struct pipeline_settings_t
+    {
+        size_t decode_threads = 8u;
+        size_t infer_threads = 1u;
+        size_t encode_threads = 4u;
+        size_t queue_size = 64u;
+        size_t batch_size = 1u;
+        std::chrono::milliseconds batch_wait = std::chrono::milliseconds(10);
+    };
+
+    /* three-stage pipeline: decode pool -> inference (batched) -> encode / write pool
+    ** stages are connected by bounded lock-free queues, so a fast stage can run at most
+    ** <queue_size> tasks ahead of the next one */
+    template <typename task_t>
+    class pipeline_t
+    {
+    public:
+        using task_ptr_t = std::unique_ptr<task_t>;
+        /* returns false to drop the task */
+        using decode_func_t = std::function<bool(task_t & task)>;
+        using infer_func_t = std::function<void(std::vector<task_t *> & batch)>;
+        using encode_func_t = std::function<void(task_t & task)>;
+        /* called for every task dropped by an exception in decode or inference, e.g. to count it as failed */
+        using fail_func_t = std::function<void(task_t & task)>;
+
+        pipeline_t() {}
+        pipeline_t(const pipeline_t &) = delete;
+        pipeline_t & operator = (const pipeline_t &) = delete;
+        ~pipeline_t() { finish(); }
+
+        void start(const pipeline_settings_t & settings, decode_func_t decode, infer_func_t infer, encode_func_t encode, fail_func_t fail = fail_func_t())
+        {
+            this->settings = settings;
+            this->settings.batch_size = std::max<size_t>(settings.batch_size, 1u);
+            decode_func = decode;
+            infer_func = infer;
+            encode_func = encode;
+            fail_func = fail;
+
+            in_queue.reset(new bounded_queue_t<task_ptr_t>(settings.queue_size));
+            decoded_queue.reset(new bounded_queue_t<task_ptr_t>(settings.queue_size));
+            inferred_queue.reset(new bounded_queue_t<task_ptr_t>(settings.queue_size));
+
+            size_t num_decode = std::max<size_t>(settings.decode_threads, 1u);
+            size_t num_infer = std::max<size_t>(settings.infer_threads, 1u);
+            size_t num_encode = std::max<size_t>(settings.encode_threads, 1u);
+            decode_running = num_decode;
+            infer_running = num_infer;
+
+            for (size_t i = 0; i < num_decode; ++i)
+                threads.emplace_back(&pipeline_t::decode_stage, this);
+            for (size_t i = 0; i < num_infer; ++i)
+                threads.emplace_back(&pipeline_t::infer_stage, this);
+            for (size_t i = 0; i < num_encode; ++i)
+                threads.emplace_back(&pipeline_t::encode_stage, this);
+        }
+
+        /* producer side, blocks while the decode queue is full */
+        bool push(task_ptr_t task)
+        {
+            return in_queue && in_queue->push(std::move(task));
+        }
+
+        /* closes the input and waits until all tasks have passed all stages */
+        void finish()
+        {
+            if (in_queue)
+                in_queue->close();
+
+            for (auto & t : threads)
+                t.join();
+            threads.clear();
+        }
+
+        size_t decode_queue_size() const { return in_queue ? in_queue->size_approx() : 0u; }
+        size_t infer_queue_size() const { return decoded_queue ? decoded_queue->size_approx() : 0u; }
+        size_t encode_queue_size() const { return inferred_queue ? inferred_queue->size_approx() : 0u; }
+
+    private:
+        template <typename func_t>
+        static void guarded(func_t func)
+        {
+            try
+            {
+                func();
+            }
+            catch (std::exception & e)
+            {
+                logger::LOG_MSG(logger::LOG_LEVEL_t::Error, e.what());
+            }
+            catch (...)
+            {
+                logger::LOG_MSG(logger::LOG_LEVEL_t::Error, "Unknown exception.");
+            }
+        }
+
+        void decode_stage()
+        {
+            task_ptr_t task;
+            while (in_queue->pop(task))
+            {
+                bool keep = false;
+                bool done = false;
+                guarded([&]() { keep = decode_func(*task); done = true; });
+
+                if (keep)
+                    decoded_queue->push(std::move(task));
+                else if (!done)
+                    failed(*task);
+            }
+
+            // the last decoder closes the next stage
+            if (--decode_running == 0)
+                decoded_queue->close();
+        }
+
+        void infer_stage()
+        {
+            std::vector<task_ptr_t> tasks;
+            std::vector<task_t *> batch;
+
+            task_ptr_t task;
+            while (decoded_queue->pop(task))
+            {
+                tasks.push_back(std::move(task));
+
+                // fill the batch, but wait no longer than batch_wait after the first task
+                auto deadline = bounded_queue_t<task_ptr_t>::clock_t::now() + settings.batch_wait;
+                while (tasks.size() < settings.batch_size && decoded_queue->pop_until(task, deadline))
+                    tasks.push_back(std::move(task));
+
+                batch.clear();
+                for (auto & t : tasks)
+                    batch.push_back(t.get());
+                // a failed batch is dropped, its errors are already logged
+                bool ok = false;
+                guarded([&]() { infer_func(batch); ok = true; });
+
+                for (auto & t : tasks)
+                    if (ok)
+                        inferred_queue->push(std::move(t));
+                    else
+                        failed(*t);
+                tasks.clear();
+            }
+
+            if (--infer_running == 0)
+                inferred_queue->close();
+        }
+
+        void failed(task_t & task)
+        {
+            if (fail_func)
+                guarded([&]() { fail_func(task); });
+        }
+
+        void encode_stage()
+        {
+            task_ptr_t task;
+            while (inferred_queue->pop(task))
+            {
+                guarded([&]() { encode_func(*task); });
+                task.reset();
+            }
+        }
+
+        pipeline_settings_t settings;
+        decode_func_t decode_func;
+        infer_func_t infer_func;
+        encode_func_t encode_func;
+        fail_func_t fail_func;
+
+        std::unique_ptr<bounded_queue_t<task_ptr_t>> in_queue;
+        std::unique_ptr<bounded_queue_t<task_ptr_t>> decoded_queue;
+        std::unique_ptr<bounded_queue_t<task_ptr_t>> inferred_queue;
+
+        std::atomic<size_t> decode_running{ 0 };
+        std::atomic<size_t> infer_running{ 0 };
+        std::vector<std::thread> threads;
+    };
+}
\ No newline at end of file
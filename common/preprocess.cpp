@@ -0,0 +1,174 @@
+#include "preprocess.h"
+
+#include <opencv2/core/hal/intrin.hpp>
+#include <opencv2/dnn.hpp>
+#include <opencv2/imgproc.hpp>
+
+#include <algorithm>
+
+namespace cmn
+{
+    namespace
+    {
+        /* geometry of cv::dnn::blobFromImage(): plain resize or aspect-preserving resize + center crop */
+        cv::Mat resize_to_input(const cv::Mat & img, cv::Mat & buf, const preprocess_param_t & params)
+        {
+            const cv::Size & size = params.size;
+            if (img.size() == size)
+                return img;
+
+            if (params.crop)
+            {
+                float resize_factor = std::max(size.width / (float)img.cols, size.height / (float)img.rows);
+                cv::resize(img, buf, cv::Size(), resize_factor, resize_factor, cv::INTER_LINEAR);
+
+                cv::Rect crop(cv::Point((int)(0.5 * (buf.cols - size.width)), (int)(0.5 * (buf.rows - size.height))), size);
+                return buf(crop);
+            }
+
+            cv::resize(img, buf, size, 0, 0, cv::INTER_LINEAR);
+            return buf;
+        }
+
+#if CV_SIMD128
+        inline void store_scaled(const cv::v_uint8x16 & v, float * dst, const cv::v_float32x4 & scale, const cv::v_float32x4 & bias)
+        {
+            cv::v_uint16x8 lo, hi;
+            cv::v_expand(v, lo, hi);
+
+            cv::v_uint32x4 q0, q1, q2, q3;
+            cv::v_expand(lo, q0, q1);
+            cv::v_expand(hi, q2, q3);
+
+            cv::v_store(dst, cv::v_fma(cv::v_cvt_f32(cv::v_reinterpret_as_s32(q0)), scale, bias));
+            cv::v_store(dst + 4, cv::v_fma(cv::v_cvt_f32(cv::v_reinterpret_as_s32(q1)), scale, bias));
+            cv::v_store(dst + 8, cv::v_fma(cv::v_cvt_f32(cv::v_reinterpret_as_s32(q2)), scale, bias));
+            cv::v_store(dst + 12, cv::v_fma(cv::v_cvt_f32(cv::v_reinterpret_as_s32(q3)), scale, bias));
+        }
+#endif // CV_SIMD128
+
+        /* (src - mean) * scale, BGR HWC -> NCHW, one pass */
+        void fill_planes_32f(const cv::Mat & src, float * dst, const preprocess_param_t & params)
+        {
+            const int width = src.cols;
+            const size_t plane = (size_t)src.rows * src.cols;
+
+            // mean is given in the output channel order, as in blobFromImage()
+            float scale = (float)params.scale_factor;
+            float bias[3];
+            float * planes[3];
+            for (int c = 0; c < 3; ++c)
+            {
+                int out_c = params.swap_RB ? 2 - c : c;
+                bias[c] = (float)(-params.mean[out_c] * params.scale_factor);
+                planes[c] = dst + out_c * plane;
+            }
+
+#if CV_SIMD128
+            const cv::v_float32x4 v_scale = cv::v_setall_f32(scale);
+            const cv::v_float32x4 v_bias0 = cv::v_setall_f32(bias[0]);
+            const cv::v_float32x4 v_bias1 = cv::v_setall_f32(bias[1]);
+            const cv::v_float32x4 v_bias2 = cv::v_setall_f32(bias[2]);
+#endif // CV_SIMD128
+
+            for (int y = 0; y < src.rows; ++y)
+            {
+                const uchar * s = src.ptr<uchar>(y);
+                float * d0 = planes[0] + (size_t)y * width;
+                float * d1 = planes[1] + (size_t)y * width;
+                float * d2 = planes[2] + (size_t)y * width;
+
+                int x = 0;
+#if CV_SIMD128
+                for (; x <= width - 16; x += 16)
+                {
+                    cv::v_uint8x16 b, g, r;
+                    cv::v_load_deinterleave(s + 3 * x, b, g, r);
+
+                    store_scaled(b, d0 + x, v_scale, v_bias0);
+                    store_scaled(g, d1 + x, v_scale, v_bias1);
+                    store_scaled(r, d2 + x, v_scale, v_bias2);
+                }
+#endif // CV_SIMD128
+                for (; x < width; ++x)
+                {
+                    d0[x] = s[3 * x] * scale + bias[0];
+                    d1[x] = s[3 * x + 1] * scale + bias[1];
+                    d2[x] = s[3 * x + 2] * scale + bias[2];
+                }
+            }
+        }
+
+        /* CV_8U blobs allow neither scaling nor mean subtraction, only the transpose and the swap */
+        void fill_planes_8u(const cv::Mat & src, uchar * dst, const preprocess_param_t & params)
+        {
+            const int width = src.cols;
+            const size_t plane = (size_t)src.rows * src.cols;
+
+            uchar * planes[3];
+            for (int c = 0; c < 3; ++c)
+                planes[c] = dst + (params.swap_RB ? 2 - c : c) * plane;
+
+            for (int y = 0; y < src.rows; ++y)
+            {
+                const uchar * s = src.ptr<uchar>(y);
+                uchar * d0 = planes[0] + (size_t)y * width;
+                uchar * d1 = planes[1] + (size_t)y * width;
+                uchar * d2 = planes[2] + (size_t)y * width;
+
+                int x = 0;
+#if CV_SIMD128
+                for (; x <= width - 16; x += 16)
+                {
+                    cv::v_uint8x16 b, g, r;
+                    cv::v_load_deinterleave(s + 3 * x, b, g, r);
+                    cv::v_store(d0 + x, b);
+                    cv::v_store(d1 + x, g);
+                    cv::v_store(d2 + x, r);
+                }
+#endif // CV_SIMD128
+                for (; x < width; ++x)
+                {
+                    d0[x] = s[3 * x];
+                    d1[x] = s[3 * x + 1];
+                    d2[x] = s[3 * x + 2];
+                }
+            }
+        }
+    }
+
+    void blob_from_images(const std::vector<cv::Mat> & imgs, cv::Mat & blob, const preprocess_param_t & params)
+    {
+        bool supported = (params.ddepth == CV_32F || params.ddepth == CV_8U) && !params.size.empty();
+        // let blobFromImages() reject scaling and mean subtraction of CV_8U blobs instead of silently skipping them
+        if (params.ddepth == CV_8U && (params.scale_factor != 1.0 || params.mean != cv::Scalar()))
+            supported = false;
+        for (size_t i = 0; supported && i < imgs.size(); ++i)
+            supported = (imgs[i].type() == CV_8UC3);
+
+        if (!supported)
+        {
+            blob = cv::dnn::blobFromImages(imgs, params.scale_factor, params.size, params.mean, params.swap_RB, params.crop, params.ddepth);
+            return;
+        }
+
+        // no-op when the shape is the same as on the previous call
+        int shape[] = { (int)imgs.size(), 3, params.size.height, params.size.width };
+        blob.create(4, shape, params.ddepth);
+
+        thread_local cv::Mat resized;
+        for (size_t i = 0; i < imgs.size(); ++i)
+        {
+            cv::Mat src = resize_to_input(imgs[i], resized, params);
+
+            params.ddepth == CV_32F ?
+                fill_planes_32f(src, blob.ptr<float>((int)i), params) :
+                fill_planes_8u(src, blob.ptr<uchar>((int)i), params);
+        }
+    }
+
+    void blob_from_image(const cv::Mat & img, cv::Mat & blob, const preprocess_param_t & params)
+    {
+        blob_from_images(std::vector<cv::Mat>(1, img), blob, params);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <opencv2/core.hpp>
+
+#include <vector>
+
+namespace cmn
+{
+    /* same meaning as cv::dnn::blobFromImage() arguments */
+    struct preprocess_param_t
+    {
+        cv::Size size;
+        double scale_factor = 1.;
+        cv::Scalar mean = cv::Scalar(0, 0, 0);
+        bool swap_RB = false;
+        bool crop = false;
+        int ddepth = CV_32F;
+    };
+
+    /* cv::dnn::blobFromImages() replacement
+    ** 8-bit BGR images are resized into a reusable buffer, then converted, mean-subtracted, scaled,
+    ** channel-swapped and transposed to NCHW in a single vectorized pass straight into <blob>
+    ** <blob> is reallocated only when the batch shape changes, so a thread_local blob makes it allocation-free
+    ** other image types fall back to cv::dnn::blobFromImages() */
+    void blob_from_images(const std::vector<cv::Mat> & imgs, cv::Mat & blob, const preprocess_param_t & params);
+
+    void blob_from_image(const cv::Mat & img, cv::Mat & blob, const preprocess_param_t & params);
+}
\ No newline at end of file
@@ -0,0 +1,164 @@
+#include "progress_reporter.h"
+
+#include <logger.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+
+namespace cmn
+{
+    namespace
+    {
+        // time constant of the moving average, long enough to smooth batching, short enough to show a stall
+        const double AVG_WINDOW_S = 60.;
+
+        std::string hms(double sec)
+        {
+            long long s = (long long)std::max(sec, 0.);
+            char buf[32];
+            std::snprintf(buf, sizeof(buf), "%02lld:%02lld:%02lld", s / 3600, s / 60 % 60, s % 60);
+            return buf;
+        }
+
+        std::string json_escape(const std::string & str)
+        {
+            std::string res;
+            for (char c : str)
+            {
+                if (c == '"' || c == '\\')
+                    res += '\\';
+                res += (c == '\n' || c == '\t') ? ' ' : c;
+            }
+            return res;
+        }
+    }
+
+    void progress_reporter_t::start(std::chrono::seconds interval, size_t every, const std::string & json)
+    {
+        stop();
+        if (interval.count() <= 0 && every == 0)
+            return;
+
+        // count-based lines only, the timer never fires
+        this->interval = interval.count() > 0 ? interval : std::chrono::hours(24 * 365);
+        this->every = every;
+        this->json = json;
+        stopping = false;
+        count_due = false;
+        begin = last = clock_t::now();
+        last_done = done.load(std::memory_order_relaxed);
+        avg_rate = -1.;
+
+        reporter = std::thread(&progress_reporter_t::run, this);
+    }
+
+    void progress_reporter_t::stop()
+    {
+        if (!reporter.joinable())
+            return;
+
+        {
+            std::lock_guard<std::mutex> lg(mtx);
+            stopping = true;
+        }
+        cv.notify_all();
+        reporter.join();
+    }
+
+    void progress_reporter_t::run()
+    {
+        std::unique_lock<std::mutex> lock(mtx);
+        while (true)
+        {
+            cv.wait_for(lock, interval, [this]() { return stopping || count_due; });
+            if (stopping)
+                break;
+
+            count_due = false;
+            lock.unlock();
+            report(false);
+            lock.lock();
+        }
+        lock.unlock();
+
+        report(true);
+    }
+
+    void progress_reporter_t::wake()
+    {
+        {
+            std::lock_guard<std::mutex> lg(mtx);
+            count_due = true;
+        }
+        cv.notify_all();
+    }
+
+    void progress_reporter_t::report(bool final)
+    {
+        clock_t::time_point now = clock_t::now();
+        double dt = std::chrono::duration<double>(now - last).count();
+        double elapsed = std::chrono::duration<double>(now - begin).count();
+
+        // done first, so that it never exceeds enqueued
+        size_t done = this->done.load(std::memory_order_relaxed);
+        size_t failed = this->failed.load(std::memory_order_relaxed);
+        size_t enqueued = this->enqueued.load(std::memory_order_relaxed);
+        bool scan_done = this->scan_done.load(std::memory_order_relaxed);
+
+        // the last interval is cut short, the final line reports the overall rate instead
+        double rate = final ? (elapsed > 0. ? done / elapsed : 0.) : (dt > 0. ? (done - last_done) / dt : 0.);
+        if (final || avg_rate < 0.)
+            avg_rate = rate;
+        else
+            avg_rate += (rate - avg_rate) * (1. - std::exp(-dt / AVG_WINDOW_S));
+        last = now;
+        last_done = done;
+
+        size_t remaining = enqueued > done + failed ? enqueued - done - failed : 0u;
+        double eta = avg_rate > 0. ? remaining / avg_rate : -1.;
+
+        std::string queues;
+        std::vector<size_t> depths;
+        for (const auto & g : gauges)
+        {
+            depths.push_back(g.second());
+            queues += ' ' + g.first + ' ' + std::to_string(depths.back());
+        }
+        std::string tail = extra ? extra() : std::string();
+
+        char line[512];
+        if (final)
+            std::snprintf(line, sizeof(line), "Finished %s: %zu done, %zu failed, %zu enqueued | %.1f images/s",
+                hms(elapsed).c_str(), done, failed, enqueued, rate);
+        else
+            std::snprintf(line, sizeof(line), "Progress %s: %zu done, %zu failed, %zu enqueued%s | %.1f images/s, %.1f avg | ETA %s%s",
+                hms(elapsed).c_str(), done, failed, enqueued, scan_done ? "" : " (scanning)", rate, avg_rate,
+                eta < 0. ? "unknown" : ((scan_done ? "" : ">") + hms(eta)).c_str(), queues.empty() ? "" : (" | queues" + queues).c_str());
+        logger::LOG_MSG(logger::LOG_LEVEL_t::Info, tail.empty() ? std::string(line) : std::string(line) + " | " + tail);
+
+        if (json.empty())
+            return;
+
+        // readers never see a partial file
+        std::string tmp = json + ".tmp";
+        {
+            std::ofstream out(tmp);
+            out << "{ \"elapsed_s\": " << elapsed << ", \"done\": " << done << ", \"failed\": " << failed
+                << ", \"enqueued\": " << enqueued << ", \"scan_done\": " << (scan_done ? "true" : "false")
+                << ", \"finished\": " << (final ? "true" : "false")
+                << ", \"images_per_s\": " << rate << ", \"avg_images_per_s\": " << avg_rate
+                << ", \"eta_s\": " << (final ? 0. : eta) << ", \"queues\": {";
+            for (size_t i = 0; i < gauges.size(); ++i)
+                out << (i ? ", " : " ") << '"' << gauges[i].first << "\": " << depths[i];
+            out << " }, \"extra\": \"" << json_escape(tail) << "\" }\n";
+            if (!out)
+                return;
+        }
+
+        std::error_code ec;
+        std::experimental::filesystem::v1::rename(tmp, json, ec);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace cmn
+{
+    /* background thread logging, every <interval> and / or every <every> images done, images done / failed / enqueued,
+    ** instant and moving average images/s, queue depths and ETA, optionally rewriting a .json with the same numbers
+    ** producers and stages only bump relaxed atomic counters, gauges and the extra text are polled by the reporter thread */
+    class progress_reporter_t
+    {
+    public:
+        using gauge_func_t = std::function<size_t()>;
+        /* appended to the log line, e.g. running accuracy */
+        using extra_func_t = std::function<std::string()>;
+
+        progress_reporter_t() {}
+        progress_reporter_t(const progress_reporter_t &) = delete;
+        progress_reporter_t & operator = (const progress_reporter_t &) = delete;
+        ~progress_reporter_t() { stop(); }
+
+        /* before start() */
+        void add_gauge(const std::string & name, gauge_func_t func) { gauges.emplace_back(name, func); }
+        void set_extra(extra_func_t func) { extra = func; }
+
+        /* disabled if both <interval> and <every> are 0, <json> is rewritten with every line */
+        void start(std::chrono::seconds interval, size_t every = 0, const std::string & json = std::string());
+        /* logs the final line and joins the reporter thread */
+        void stop();
+
+        void add_enqueued(size_t n = 1) { enqueued.fetch_add(n, std::memory_order_relaxed); }
+        void add_done(size_t n = 1)
+        {
+            size_t before = done.fetch_add(n, std::memory_order_relaxed);
+            if (every && before / every != (before + n) / every)
+                wake();
+        }
+        void add_failed(size_t n = 1) { failed.fetch_add(n, std::memory_order_relaxed); }
+        /* the whole input is enqueued, the ETA is exact from now on rather than a lower bound */
+        void scan_finished() { scan_done.store(true, std::memory_order_relaxed); }
+
+    private:
+        using clock_t = std::chrono::steady_clock;
+
+        void run();
+        void wake();
+        void report(bool final);
+
+        std::atomic<size_t> enqueued{ 0 };
+        std::atomic<size_t> done{ 0 };
+        std::atomic<size_t> failed{ 0 };
+        std::atomic<bool> scan_done{ false };
+
+        std::vector<std::pair<std::string, gauge_func_t>> gauges;
+        extra_func_t extra;
+
+        std::chrono::seconds interval{ 0 };
+        size_t every = 0;
+        std::string json;
+        std::thread reporter;
+        std::mutex mtx;
+        std::condition_variable cv;
+        bool stopping = false;
+        bool count_due = false;
+
+        // owned by the reporter thread
+        clock_t::time_point begin;
+        clock_t::time_point last;
+        size_t last_done = 0;
+        double avg_rate = -1.;
+    };
+}
\ No newline at end of file
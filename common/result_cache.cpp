@@ -0,0 +1,157 @@
+#include "result_cache.h"
+#include "hash.h"
+
+#include <filesystem>
+
+namespace cmn
+{
+    namespace
+    {
+        const char MAGIC[8] = { 'C', 'N', 'N', 'T', 'R', 'C', '0', '1' };
+
+        template <typename T>
+        T read_pod(const unsigned char * p)
+        {
+            T v;
+            std::memcpy(&v, p, sizeof(T));
+            return v;
+        }
+    }
+
+    uint64_t result_cache_t::make_key(uint64_t content_hash, uint64_t model_hash)
+    {
+        return hash_combine(content_hash, model_hash);
+    }
+
+    bool result_cache_t::open(const std::string & filename)
+    {
+        close();
+
+        namespace fs = std::experimental::filesystem::v1;
+        bool exists = fs::exists(filename) && fs::file_size(filename) > 0;
+
+        if (exists)
+        {
+            if (!mapped.open(filename))
+                return false;
+
+            if (mapped.size() < sizeof(MAGIC) || std::memcmp(mapped.data(), MAGIC, sizeof(MAGIC)) != 0)
+            {
+                mapped.close();
+                return false;
+            }
+
+            // a run that crashed mid-write leaves a partial record, drop it before appending
+            size_t valid_end = build_index();
+            if (valid_end < mapped.size())
+            {
+                mapped.close();
+                fs::resize_file(filename, valid_end);
+                if (!mapped.open(filename))
+                    return false;
+                build_index();
+            }
+        }
+
+        out.open(filename, std::ios::binary | std::ios::app);
+        if (!out.is_open())
+            return false;
+
+        if (!exists)
+            out.write(MAGIC, sizeof(MAGIC));
+
+        return true;
+    }
+
+    void result_cache_t::close()
+    {
+        std::lock_guard<std::mutex> lg(out_mutex);
+        if (out.is_open())
+            out.close();
+        index.clear();
+        mapped.close();
+    }
+
+    size_t result_cache_t::build_index()
+    {
+        index.clear();
+
+        const unsigned char * data = mapped.data();
+        const size_t len = mapped.size();
+        size_t pos = sizeof(MAGIC);
+
+        while (pos + sizeof(uint64_t) + sizeof(uint32_t) <= len)
+        {
+            size_t rec_start = pos;
+            uint64_t key = read_pod<uint64_t>(data + pos);
+            uint32_t num_parts = read_pod<uint32_t>(data + pos + sizeof(uint64_t));
+            pos += sizeof(uint64_t) + sizeof(uint32_t);
+
+            bool complete = true;
+            for (uint32_t i = 0; complete && i < num_parts; ++i)
+            {
+                if (pos + sizeof(uint32_t) > len)
+                {
+                    complete = false;
+                    break;
+                }
+
+                uint32_t count = read_pod<uint32_t>(data + pos);
+                pos += sizeof(uint32_t);
+                if (pos + (size_t)count * sizeof(float) > len)
+                    complete = false;
+                pos += (size_t)count * sizeof(float);
+            }
+
+            if (!complete)
+                return rec_start;
+
+            // later records win, e.g. after a model file was replaced in place
+            index[key] = rec_start;
+        }
+
+        return pos;
+    }
+
+    bool result_cache_t::find(uint64_t key, std::vector<part_t> & parts) const
+    {
+        parts.clear();
+
+        auto it = index.find(key);
+        if (it == index.end())
+            return false;
+
+        const unsigned char * p = mapped.data() + it->second + sizeof(uint64_t);
+        uint32_t num_parts = read_pod<uint32_t>(p);
+        p += sizeof(uint32_t);
+
+        for (uint32_t i = 0; i < num_parts; ++i)
+        {
+            uint32_t count = read_pod<uint32_t>(p);
+            p += sizeof(uint32_t);
+
+            // all fields are 4 bytes wide, so floats stay aligned within the mapping
+            parts.push_back(part_t{ (const float *)p, count });
+            p += (size_t)count * sizeof(float);
+        }
+
+        return true;
+    }
+
+    void result_cache_t::append(uint64_t key, const std::vector<part_t> & parts)
+    {
+        std::lock_guard<std::mutex> lg(out_mutex);
+        if (!out.is_open())
+            return;
+
+        uint32_t num_parts = (uint32_t)parts.size();
+        out.write((const char *)&key, sizeof(key));
+        out.write((const char *)&num_parts, sizeof(num_parts));
+        for (const auto & part : parts)
+        {
+            uint32_t count = (uint32_t)part.size;
+            out.write((const char *)&count, sizeof(count));
+            out.write((const char *)part.data, (std::streamsize)(part.size * sizeof(float)));
+        }
+    }
+}
\ No newline at end of file
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace cmn
+{
+    /* persistent cache of raw network outputs, keyed by image content hash and model identity
+    ** single append-only binary file:
+    **     header: magic[8]
+    **     record: u64 key | u32 num_parts | num_parts x (u32 count | float[count])
+    ** records written by earlier runs are memory-mapped and indexed on open(),
+    ** records appended during the run become visible on the next open() */
+    class result_cache_t
+    {
+    public:
+        struct part_t
+        {
+            const float * data;
+            size_t size;
+        };
+
+        result_cache_t() {}
+        result_cache_t(const result_cache_t &) = delete;
+        result_cache_t & operator = (const result_cache_t &) = delete;
+        ~result_cache_t() { close(); }
+
+        bool open(const std::string & filename);
+        void close();
+        bool is_open() const { return out.is_open(); }
+
+        /* thread-safe, <parts> point into the mapped file */
+        bool find(uint64_t key, std::vector<part_t> & parts) const;
+        /* thread-safe */
+        void append(uint64_t key, const std::vector<part_t> & parts);
+
+        size_t size() const { return index.size(); }
+
+        static uint64_t make_key(uint64_t content_hash, uint64_t model_hash);
+
+    private:
+        /* returns end offset of the last complete record */
+        size_t build_index();
+
+        mapped_file_t mapped;
+        std::unordered_map<uint64_t, size_t> index;
+
+        std::mutex out_mutex;
+        std::ofstream out;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,108 @@
+#include "run_journal.h"
+
+#include <cstring>
+#include <filesystem>
+
+namespace cmn
+{
+    namespace
+    {
+        const char MAGIC[8] = { 'C', 'N', 'N', 'T', 'J', 'R', '0', '1' };
+        const size_t HEADER_SIZE = sizeof(MAGIC) + sizeof(uint64_t) + sizeof(uint32_t);
+    }
+
+    bool run_journal_t::open(const std::string & filename, uint64_t config_key, size_t payload_size, bool resume)
+    {
+        close();
+
+        namespace fs = std::experimental::filesystem::v1;
+        std::error_code ec;
+        this->payload_size = payload_size;
+        const size_t record_size = sizeof(uint64_t) + payload_size;
+
+        size_t valid_end = 0;
+        if (resume && fs::exists(filename, ec) && fs::file_size(filename, ec) > 0)
+        {
+            if (!mapped.open(filename) || mapped.size() < HEADER_SIZE || std::memcmp(mapped.data(), MAGIC, sizeof(MAGIC)) != 0)
+            {
+                mapped.close();
+                return false;
+            }
+
+            uint64_t key = 0;
+            uint32_t size = 0;
+            std::memcpy(&key, mapped.data() + sizeof(MAGIC), sizeof(key));
+            std::memcpy(&size, mapped.data() + sizeof(MAGIC) + sizeof(key), sizeof(size));
+            if (key != config_key || size != payload_size)
+            {
+                mapped.close();
+                return false;
+            }
+
+            // a run that crashed mid-write leaves a partial record
+            num_resumed = (mapped.size() - HEADER_SIZE) / record_size;
+            valid_end = HEADER_SIZE + num_resumed * record_size;
+
+            done.reserve(num_resumed);
+            for (size_t i = 0; i < num_resumed; ++i)
+            {
+                uint64_t input_key;
+                std::memcpy(&input_key, mapped.data() + HEADER_SIZE + i * record_size, sizeof(input_key));
+                done.insert(input_key);
+            }
+        }
+
+        if (valid_end)
+        {
+            // appends must not land after the partial record, it stays readable through the mapping until close()
+            if (valid_end < mapped.size())
+            {
+                mapped.close();
+                fs::resize_file(filename, valid_end, ec);
+                if (ec || !mapped.open(filename))
+                    return false;
+            }
+            out.open(filename, std::ios::binary | std::ios::app);
+        }
+        else
+        {
+            out.open(filename, std::ios::binary | std::ios::trunc);
+            uint32_t size = (uint32_t)payload_size;
+            out.write(MAGIC, sizeof(MAGIC));
+            out.write((const char *)&config_key, sizeof(config_key));
+            out.write((const char *)&size, sizeof(size));
+        }
+
+        num_records = num_resumed;
+        return out.is_open() && (bool)out;
+    }
+
+    void run_journal_t::close()
+    {
+        if (out.is_open())
+            out.close();
+        mapped.close();
+        done.clear();
+        num_resumed = 0;
+        num_records = 0;
+    }
+
+    void run_journal_t::replay(size_t first, const std::function<void(uint64_t key, const unsigned char * payload)> & func) const
+    {
+        const size_t record_size = sizeof(uint64_t) + payload_size;
+        for (size_t i = first; i < num_resumed; ++i)
+        {
+            const unsigned char * rec = mapped.data() + HEADER_SIZE + i * record_size;
+            uint64_t key;
+            std::memcpy(&key, rec, sizeof(key));
+            func(key, rec + sizeof(key));
+        }
+    }
+
+    void run_journal_t::append(uint64_t key, const void * payload)
+    {
+        out.write((const char *)&key, sizeof(key));
+        out.write((const char *)payload, payload_size);
+        ++num_records;
+    }
+}
\ No newline at end of file
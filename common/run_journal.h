@@ -0,0 +1,53 @@
+#pragma once
+
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <unordered_set>
+
+namespace cmn
+{
+    /* append-only journal of completed inputs, e.g. for resuming an interrupted run
+    ** single binary file:
+    **     header: magic[8] | u64 config key | u32 payload size
+    **     record: u64 input key | payload[payload size]
+    ** a resumed journal keeps the complete records of the earlier run and indexes their keys, a fresh one is truncated
+    ** appends go through a buffered stream and are not thread-safe */
+    class run_journal_t
+    {
+    public:
+        run_journal_t() {}
+        run_journal_t(const run_journal_t &) = delete;
+        run_journal_t & operator = (const run_journal_t &) = delete;
+        ~run_journal_t() { close(); }
+
+        /* fails if <filename> can't be opened or was written with another <config_key> / <payload_size> */
+        bool open(const std::string & filename, uint64_t config_key, size_t payload_size, bool resume);
+        void close();
+        bool is_open() const { return out.is_open(); }
+
+        /* completed by the earlier run */
+        bool contains(uint64_t key) const { return done.count(key) != 0; }
+        size_t resumed() const { return num_resumed; }
+        /* records of the earlier run from <first> on, in append order */
+        void replay(size_t first, const std::function<void(uint64_t key, const unsigned char * payload)> & func) const;
+
+        void append(uint64_t key, const void * payload);
+        /* records written so far, including resumed ones */
+        size_t records() const { return num_records; }
+        /* appended records survive a crash of the process from now on */
+        void flush() { out.flush(); }
+
+    private:
+        mapped_file_t mapped;
+        std::unordered_set<uint64_t> done;
+        size_t payload_size = 0;
+        size_t num_resumed = 0;
+        size_t num_records = 0;
+
+        std::ofstream out;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,228 @@
+#include "shard_writer.h"
+
+#include <logger.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+
+namespace cmn
+{
+    using LL = logger::LOG_LEVEL_t;
+
+    namespace
+    {
+        const uint64_t TAR_BLOCK = 512;
+        const size_t WRITE_BUFFER_SIZE = 4 << 20;
+        const size_t NAME_SIZE = 100;
+        const size_t PREFIX_SIZE = 155;
+
+        inline uint64_t padded(uint64_t size)
+        {
+            return (size + TAR_BLOCK - 1) / TAR_BLOCK * TAR_BLOCK;
+        }
+    }
+
+    bool shard_writer_t::open(const std::string & dir, const std::string & prefix, uint64_t max_shard_size, size_t queue_size)
+    {
+        close();
+
+        this->dir = dir;
+        this->prefix = prefix;
+        this->max_shard_size = max_shard_size;
+        shard_id = 0;
+        failed = false;
+        num_members = 0;
+
+        index.open(dir + '/' + prefix + ".index.csv");
+        if (!index.is_open())
+            return false;
+        index << "shard,offset,size,name\n";
+
+        if (!next_shard())
+            return false;
+
+        queue.reset(new bounded_queue_t<std::unique_ptr<member_t>>(std::max<size_t>(queue_size, 2u)));
+        writer = std::thread(&shard_writer_t::run, this);
+        return true;
+    }
+
+    void shard_writer_t::close()
+    {
+        if (!queue)
+            return;
+
+        queue->close();
+        if (writer.joinable())
+            writer.join();
+        queue.reset();
+
+        finish_shard();
+        index.close();
+    }
+
+    bool shard_writer_t::write(const std::string & name, std::vector<unsigned char> && data, written_func_t on_written)
+    {
+        std::unique_ptr<member_t> member(new member_t);
+        member->name = name;
+        member->data = std::move(data);
+        member->on_written = on_written;
+        return queue && queue->push(std::move(member));
+    }
+
+    void shard_writer_t::run()
+    {
+        std::unique_ptr<member_t> member;
+        while (queue->pop(member))
+        {
+            if (failed)
+            {
+                logger::LOG_MSG(LL::Error, "Shard writer failed, member is dropped: " + member->name);
+                continue;
+            }
+
+            uint64_t size = member->data.size();
+            uint64_t record = (member->name.size() > NAME_SIZE ? TAR_BLOCK + padded(member->name.size() + 1) : 0) + TAR_BLOCK + padded(size);
+
+            // a shard is never empty, an oversized member gets a shard of its own
+            if (shard_size && shard_size + record + 2 * TAR_BLOCK > max_shard_size)
+            {
+                flush_written();
+                finish_shard();
+                if (!next_shard())
+                    continue;
+            }
+
+            write_header(member->name, size, '0');
+            uint64_t offset = shard_size;
+            shard.write((const char *)member->data.data(), (std::streamsize)size);
+            write_padding(size);
+            shard_size += padded(size);
+
+            if (!shard)
+            {
+                logger::LOG_MSG(LL::Error, "Failed to write shard: " + shard_name);
+                failed = true;
+                continue;
+            }
+
+            // only members whose data made it to the shard are indexed
+            index << shard_name << ',' << offset << ',' << size << ',' << member->name << '\n';
+            ++num_members;
+
+            // flushed when idle or once a write buffer is filled, so writes stay large
+            if (member->on_written)
+                written.push_back(std::move(member->on_written));
+            unflushed += record;
+            if (unflushed >= WRITE_BUFFER_SIZE || queue->size_approx() == 0)
+                flush_written();
+        }
+
+        flush_written();
+    }
+
+    void shard_writer_t::flush_written()
+    {
+        unflushed = 0;
+        if (written.empty())
+            return;
+
+        if (!failed && shard.is_open() && shard.flush())
+        {
+            for (const auto & func : written)
+                func();
+        }
+        else
+        {
+            logger::LOG_MSG(LL::Error, "Failed to flush shard: " + shard_name + ", " + std::to_string(written.size()) + " members may be lost.");
+            failed = true;
+        }
+        written.clear();
+    }
+
+    bool shard_writer_t::next_shard()
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "-%06zu.tar", shard_id++);
+        shard_name = prefix + name;
+        shard_size = 0;
+
+        // large sequential writes, set before the stream is opened
+        write_buffer.resize(WRITE_BUFFER_SIZE);
+        shard.rdbuf()->pubsetbuf(write_buffer.data(), (std::streamsize)write_buffer.size());
+        shard.open(dir + '/' + shard_name, std::ios::binary | std::ios::trunc);
+        if (!shard.is_open())
+        {
+            logger::LOG_MSG(LL::Error, "Failed to open shard: " + dir + '/' + shard_name);
+            failed = true;
+            return false;
+        }
+
+        return true;
+    }
+
+    void shard_writer_t::finish_shard()
+    {
+        if (!shard.is_open())
+            return;
+
+        // end of archive: two zero blocks
+        const char zeros[2 * TAR_BLOCK] = {};
+        shard.write(zeros, sizeof(zeros));
+        shard.close();
+    }
+
+    void shard_writer_t::write_header(const std::string & name, uint64_t size, char type)
+    {
+        std::string short_name = name;
+        std::string name_prefix;
+
+        if (name.size() > NAME_SIZE)
+        {
+            // ustar prefix split at a '/', GNU long name record if there is none fitting
+            size_t split = name.find('/', name.size() - NAME_SIZE - 1);
+            if (split != std::string::npos && split <= PREFIX_SIZE && split > 0)
+            {
+                name_prefix = name.substr(0, split);
+                short_name = name.substr(split + 1);
+            }
+            else
+            {
+                write_header("././@LongLink", name.size() + 1, 'L');
+                shard.write(name.c_str(), (std::streamsize)name.size() + 1);
+                write_padding(name.size() + 1);
+                shard_size += padded(name.size() + 1);
+                short_name = name.substr(0, NAME_SIZE);
+            }
+        }
+
+        char header[TAR_BLOCK] = {};
+        std::memcpy(header, short_name.data(), std::min(short_name.size(), NAME_SIZE));
+        std::snprintf(header + 100, 8, "%07o", 0644u);
+        std::snprintf(header + 108, 8, "%07o", 0u);
+        std::snprintf(header + 116, 8, "%07o", 0u);
+        std::snprintf(header + 124, 12, "%011llo", (unsigned long long)size);
+        std::snprintf(header + 136, 12, "%011llo", (unsigned long long)std::time(nullptr));
+        header[156] = type;
+        std::memcpy(header + 257, "ustar", 6);
+        std::memcpy(header + 263, "00", 2);
+        std::memcpy(header + 345, name_prefix.data(), std::min(name_prefix.size(), PREFIX_SIZE));
+
+        std::memset(header + 148, ' ', 8);
+        unsigned int sum = 0;
+        for (size_t i = 0; i < TAR_BLOCK; ++i)
+            sum += (unsigned char)header[i];
+        std::snprintf(header + 148, 8, "%06o", sum);
+        header[155] = ' ';
+
+        shard.write(header, TAR_BLOCK);
+        shard_size += TAR_BLOCK;
+    }
+
+    void shard_writer_t::write_padding(uint64_t size)
+    {
+        const char zeros[TAR_BLOCK] = {};
+        shard.write(zeros, (std::streamsize)(padded(size) - size));
+    }
+}
\ No newline at end of file
@@ -0,0 +1,78 @@
+#pragma once
+
+#include "bounded_queue.h"
+
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace cmn
+{
+    /* appends files to rolling tar shards <dir>/<prefix>-NNNNNN.tar of up to <max_shard_size> bytes
+    ** a single writer thread does all file I/O in large sequential writes, producers only enqueue encoded data
+    ** <dir>/<prefix>.index.csv lists "shard,offset,size,name" of every member, offset is the one of its data */
+    class shard_writer_t
+    {
+    public:
+        /* called on the writer thread once the member's data is flushed to its shard */
+        using written_func_t = std::function<void()>;
+
+        shard_writer_t() {}
+        shard_writer_t(const shard_writer_t &) = delete;
+        shard_writer_t & operator = (const shard_writer_t &) = delete;
+        ~shard_writer_t() { close(); }
+
+        bool open(const std::string & dir, const std::string & prefix, uint64_t max_shard_size, size_t queue_size = 64);
+        /* drains the queue and finalizes the last shard */
+        void close();
+        bool is_open() const { return queue != nullptr; }
+
+        /* thread-safe, blocks while the writer is behind by more than <queue_size> members
+        ** <name> is '/' separated, relative to the shard root, <on_written> is never called for a member lost on a write error */
+        bool write(const std::string & name, std::vector<unsigned char> && data, written_func_t on_written = written_func_t());
+
+        size_t members() const { return num_members.load(); }
+        size_t shards() const { return shard_id; }
+
+    private:
+        struct member_t
+        {
+            std::string name;
+            std::vector<unsigned char> data;
+            written_func_t on_written;
+        };
+
+        void run();
+        /* flushes the shard, then runs callbacks of the members written since the last flush */
+        void flush_written();
+        bool next_shard();
+        void finish_shard();
+        void write_header(const std::string & name, uint64_t size, char type);
+        void write_padding(uint64_t size);
+
+        std::string dir;
+        std::string prefix;
+        uint64_t max_shard_size = 0;
+
+        std::unique_ptr<bounded_queue_t<std::unique_ptr<member_t>>> queue;
+        std::thread writer;
+
+        // owned by the writer thread
+        std::vector<char> write_buffer;
+        std::ofstream shard;
+        std::ofstream index;
+        std::string shard_name;
+        uint64_t shard_size = 0;
+        size_t shard_id = 0;
+        bool failed = false;
+        std::vector<written_func_t> written;
+        uint64_t unflushed = 0;
+
+        std::atomic<size_t> num_members{ 0 };
+    };
+}
\ No newline at end of file
@@ -0,0 +1,204 @@
+#include "stage_timers.h"
+
+#include <logger.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif // _MSC_VER
+
+namespace cmn
+{
+    namespace
+    {
+        inline unsigned msb(uint64_t v)
+        {
+#       ifdef _MSC_VER
+            unsigned long idx;
+            _BitScanReverse64(&idx, v);
+            return (unsigned)idx;
+#       else
+            return 63u - (unsigned)__builtin_clzll(v);
+#       endif // _MSC_VER
+        }
+
+        inline double to_ms(uint64_t ns)
+        {
+            return ns / 1e6;
+        }
+
+        const double PERCENTILES[] = { 0.5, 0.9, 0.95, 0.99, 0.999 };
+    }
+
+    size_t latency_histogram_t::bucket(uint64_t ns)
+    {
+        if (ns < (1u << SUB_BITS))
+            return (size_t)ns;
+
+        unsigned shift = msb(ns) - SUB_BITS;
+        return ((size_t)(shift + 1) << SUB_BITS) + (size_t)((ns >> shift) - (1u << SUB_BITS));
+    }
+
+    uint64_t latency_histogram_t::upper_bound(size_t bucket)
+    {
+        if (bucket < (1u << SUB_BITS))
+            return bucket;
+
+        unsigned shift = (unsigned)(bucket >> SUB_BITS) - 1;
+        uint64_t sub = bucket & ((1u << SUB_BITS) - 1);
+        return (((1u << SUB_BITS) + sub) << shift) + ((uint64_t(1) << shift) - 1);
+    }
+
+    void latency_histogram_t::merge(const latency_histogram_t & other)
+    {
+        for (size_t i = 0; i < NUM_BUCKETS; ++i)
+            buckets[i] += other.buckets[i];
+        total += other.total;
+        sum_ns += other.sum_ns;
+        max_ns = std::max(max_ns, other.max_ns);
+    }
+
+    uint64_t latency_histogram_t::percentile(double q) const
+    {
+        if (!total)
+            return 0;
+
+        uint64_t rank = std::max<uint64_t>((uint64_t)(q * total + 0.5), 1u);
+        uint64_t seen = 0;
+        for (size_t i = 0; i < NUM_BUCKETS; ++i)
+        {
+            seen += buckets[i];
+            if (seen >= rank)
+                return std::min(upper_bound(i), max_ns);
+        }
+
+        return max_ns;
+    }
+
+    std::vector<std::pair<uint64_t, uint64_t>> latency_histogram_t::nonempty() const
+    {
+        std::vector<std::pair<uint64_t, uint64_t>> res;
+        for (size_t i = 0; i < NUM_BUCKETS; ++i)
+            if (buckets[i])
+                res.emplace_back(upper_bound(i), buckets[i]);
+        return res;
+    }
+
+    size_t stage_timers_t::add(const std::string & name)
+    {
+        stages.push_back(name);
+        return stages.size() - 1;
+    }
+
+    void stage_timers_t::record(size_t stage, timer_clock_t::duration d)
+    {
+        shard_t & shard = local_shard();
+        if (stage < shard.hist.size())
+            shard.hist[stage].record((uint64_t)std::max<int64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(d).count(), 0));
+    }
+
+    stage_timers_t::shard_t & stage_timers_t::local_shard()
+    {
+        thread_local std::vector<std::pair<const stage_timers_t *, shard_t *>> cached;
+        for (auto & c : cached)
+            if (c.first == this)
+                return *c.second;
+
+        // first call on this thread
+        std::unique_ptr<shard_t> shard(new shard_t);
+        shard->hist.resize(stages.size());
+        shard_t * ptr = shard.get();
+        {
+            std::lock_guard<std::mutex> lg(shards_mutex);
+            shards.push_back(std::move(shard));
+        }
+        cached.emplace_back(this, ptr);
+        return *ptr;
+    }
+
+    std::vector<latency_histogram_t> stage_timers_t::merged() const
+    {
+        std::vector<latency_histogram_t> res(stages.size());
+        std::lock_guard<std::mutex> lg(shards_mutex);
+        for (const auto & shard : shards)
+            for (size_t i = 0; i < shard->hist.size(); ++i)
+                res[i].merge(shard->hist[i]);
+        return res;
+    }
+
+    void stage_timers_t::print() const
+    {
+        std::vector<latency_histogram_t> hist = merged();
+        double sec = std::chrono::duration<double>(end - begin).count();
+
+        std::string table = "Stage timings, ms:\n";
+        char line[256];
+        std::snprintf(line, sizeof(line), "%-16s %10s %10s %10s %10s %10s %12s\n", "stage", "count", "p50", "p95", "p99", "max", "total, s");
+        table += line;
+        for (size_t i = 0; i < stages.size(); ++i)
+        {
+            const auto & h = hist[i];
+            if (!h.count())
+                continue;
+            std::snprintf(line, sizeof(line), "%-16s %10llu %10.3f %10.3f %10.3f %10.3f %12.3f\n",
+                stages[i].c_str(), (unsigned long long)h.count(),
+                to_ms(h.percentile(0.5)), to_ms(h.percentile(0.95)), to_ms(h.percentile(0.99)), to_ms(h.max()), h.sum() / 1e9);
+            table += line;
+        }
+
+        double mb_read = bytes_read.load() / 1048576.;
+        double mb_written = bytes_written.load() / 1048576.;
+        std::snprintf(line, sizeof(line), "%llu images in %.3f s, %.1f images/s, read %.1f MB (%.1f MB/s), written %.1f MB (%.1f MB/s)",
+            (unsigned long long)images.load(), sec, sec > 0 ? images.load() / sec : 0.,
+            mb_read, sec > 0 ? mb_read / sec : 0., mb_written, sec > 0 ? mb_written / sec : 0.);
+        table += line;
+
+        logger::LOG_MSG(logger::LOG_LEVEL_t::Info, table);
+    }
+
+    bool stage_timers_t::save_json(const std::string & filename) const
+    {
+        std::ofstream out(filename);
+        if (!out.is_open())
+            return false;
+
+        std::vector<latency_histogram_t> hist = merged();
+        double sec = std::chrono::duration<double>(end - begin).count();
+
+        // stage names are identifiers, nothing to escape
+        out << "{\n"
+            << "  \"elapsed_s\": " << sec << ",\n"
+            << "  \"images\": " << images.load() << ",\n"
+            << "  \"images_per_s\": " << (sec > 0 ? images.load() / sec : 0.) << ",\n"
+            << "  \"bytes_read\": " << bytes_read.load() << ",\n"
+            << "  \"bytes_written\": " << bytes_written.load() << ",\n"
+            << "  \"stages\": [";
+
+        for (size_t i = 0; i < stages.size(); ++i)
+        {
+            const auto & h = hist[i];
+            out << (i ? "," : "") << "\n    { \"name\": \"" << stages[i] << "\", \"count\": " << h.count()
+                << ", \"total_ns\": " << h.sum() << ", \"max_ns\": " << h.max();
+            for (double q : PERCENTILES)
+            {
+                char key[16];
+                std::snprintf(key, sizeof(key), "p%g", q * 100);
+                std::string name(key);
+                std::replace(name.begin(), name.end(), '.', '_');
+                out << ", \"" << name << "_ns\": " << h.percentile(q);
+            }
+
+            // (bucket upper bound ns, count), enough to rebuild the histogram
+            out << ", \"buckets\": [";
+            auto buckets = h.nonempty();
+            for (size_t j = 0; j < buckets.size(); ++j)
+                out << (j ? ", " : "") << '[' << buckets[j].first << ", " << buckets[j].second << ']';
+            out << "] }";
+        }
+        out << "\n  ]\n}\n";
+
+        return (bool)out;
+    }
+}
\ No newline at end of file
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace cmn
+{
+    /* log-linear latency histogram (HDR style) in ns: values below 2^SUB_BITS are exact,
+    ** every further power of two is split into 2^SUB_BITS buckets, so a percentile is within 1 / 2^SUB_BITS of the true value */
+    class latency_histogram_t
+    {
+    public:
+        static const unsigned SUB_BITS = 5;
+        static const size_t NUM_BUCKETS = (64 - SUB_BITS + 1) << SUB_BITS;
+
+        void record(uint64_t ns)
+        {
+            ++buckets[bucket(ns)];
+            ++total;
+            sum_ns += ns;
+            if (ns > max_ns)
+                max_ns = ns;
+        }
+
+        void merge(const latency_histogram_t & other);
+
+        uint64_t count() const { return total; }
+        uint64_t sum() const { return sum_ns; }
+        uint64_t max() const { return max_ns; }
+        /* upper bound of the bucket holding the <q> quantile, q in [0, 1] */
+        uint64_t percentile(double q) const;
+        /* (upper bound, count) of non-empty buckets */
+        std::vector<std::pair<uint64_t, uint64_t>> nonempty() const;
+
+        static size_t bucket(uint64_t ns);
+        static uint64_t upper_bound(size_t bucket);
+
+    private:
+        std::array<uint64_t, NUM_BUCKETS> buckets{};
+        uint64_t total = 0;
+        uint64_t sum_ns = 0;
+        uint64_t max_ns = 0;
+    };
+
+    /* wall time per pipeline stage plus throughput counters
+    ** every thread records into a shard of its own, shards are merged only by print() / save_json() */
+    class stage_timers_t
+    {
+    public:
+        using timer_clock_t = std::chrono::steady_clock;
+
+        /* times the enclosing scope */
+        class scope_t
+        {
+        public:
+            scope_t(stage_timers_t * timers, size_t stage) : timers(timers), stage(stage), begin(timers ? timer_clock_t::now() : timer_clock_t::time_point()) {}
+            scope_t(stage_timers_t & timers, size_t stage) : scope_t(&timers, stage) {}
+            scope_t(const scope_t &) = delete;
+            scope_t & operator = (const scope_t &) = delete;
+            ~scope_t()
+            {
+                if (timers)
+                    timers->record(stage, timer_clock_t::now() - begin);
+            }
+
+        private:
+            stage_timers_t * timers;
+            size_t stage;
+            timer_clock_t::time_point begin;
+        };
+
+        stage_timers_t() {}
+        stage_timers_t(const stage_timers_t &) = delete;
+        stage_timers_t & operator = (const stage_timers_t &) = delete;
+
+        /* registers a stage and returns its id, all stages are added before the first record() */
+        size_t add(const std::string & name);
+        void record(size_t stage, timer_clock_t::duration d);
+
+        void add_images(size_t n) { images.fetch_add(n, std::memory_order_relaxed); }
+        void add_read(uint64_t bytes) { bytes_read.fetch_add(bytes, std::memory_order_relaxed); }
+        void add_written(uint64_t bytes) { bytes_written.fetch_add(bytes, std::memory_order_relaxed); }
+
+        /* throughput is measured over [start(), stop()] */
+        void start() { begin = timer_clock_t::now(); end = begin; }
+        void stop() { end = timer_clock_t::now(); }
+
+        /* per-stage p50 / p95 / p99 / max table, images/sec and I/O volume */
+        void print() const;
+        bool save_json(const std::string & filename) const;
+
+    private:
+        struct shard_t
+        {
+            std::vector<latency_histogram_t> hist;
+        };
+
+        shard_t & local_shard();
+        std::vector<latency_histogram_t> merged() const;
+
+        std::vector<std::string> stages;
+        std::vector<std::unique_ptr<shard_t>> shards;
+        mutable std::mutex shards_mutex;
+
+        std::atomic<uint64_t> images{ 0 };
+        std::atomic<uint64_t> bytes_read{ 0 };
+        std::atomic<uint64_t> bytes_written{ 0 };
+        timer_clock_t::time_point begin;
+        timer_clock_t::time_point end;
+    };
+}
\ No newline at end of file
@@ -0,0 +1,111 @@
+#include "topk.h"
+
+#include <opencv2/core/hal/intrin.hpp>
+
+#include <algorithm>
+
+namespace cmn
+{
+    namespace
+    {
+        const size_t HEAP_MAX_K = 64;
+
+        auto score_desc = [](const score_t & l, const score_t & r) { return l.second > r.second || (l.second == r.second && l.first < r.first); };
+    }
+
+    size_t argmax(const float * data, size_t n)
+    {
+        size_t i = 0;
+        float max_val = data[0];
+
+#if CV_SIMD128
+        if (n >= 16)
+        {
+            cv::v_float32x4 m0 = cv::v_load(data);
+            cv::v_float32x4 m1 = m0, m2 = m0, m3 = m0;
+            for (; i + 16 <= n; i += 16)
+            {
+                m0 = cv::v_max(m0, cv::v_load(data + i));
+                m1 = cv::v_max(m1, cv::v_load(data + i + 4));
+                m2 = cv::v_max(m2, cv::v_load(data + i + 8));
+                m3 = cv::v_max(m3, cv::v_load(data + i + 12));
+            }
+            max_val = cv::v_reduce_max(cv::v_max(cv::v_max(m0, m1), cv::v_max(m2, m3)));
+        }
+#endif // CV_SIMD128
+
+        for (; i < n; ++i)
+            max_val = std::max(max_val, data[i]);
+
+        // second pass stops at the first hit, usually well before the end
+        for (i = 0; i < n; ++i)
+            if (data[i] == max_val)
+                return i;
+
+        return 0;
+    }
+
+    void topk(const float * data, size_t n, size_t k, std::vector<score_t> & out)
+    {
+        k = std::min(k, n);
+        out.clear();
+        if (k == 0)
+            return;
+
+        if (k == 1)
+        {
+            size_t idx = argmax(data, n);
+            out.push_back(std::make_pair(idx, data[idx]));
+            return;
+        }
+
+        if (k > HEAP_MAX_K)
+        {
+            out.resize(n);
+            for (size_t i = 0; i < n; ++i)
+                out[i] = std::make_pair(i, data[i]);
+
+            std::nth_element(out.begin(), out.begin() + (k - 1), out.end(), score_desc);
+            out.resize(k);
+            std::sort(out.begin(), out.end(), score_desc);
+            return;
+        }
+
+        // min-heap of the best k so far, out.front() is the weakest of them
+        for (size_t i = 0; i < k; ++i)
+            out.push_back(std::make_pair(i, data[i]));
+        std::make_heap(out.begin(), out.end(), score_desc);
+
+        auto push = [&](size_t i)
+        {
+            if (data[i] > out.front().second)
+            {
+                std::pop_heap(out.begin(), out.end(), score_desc);
+                out.back() = std::make_pair(i, data[i]);
+                std::push_heap(out.begin(), out.end(), score_desc);
+            }
+        };
+
+        size_t i = k;
+#if CV_SIMD128
+        for (; i + 16 <= n; i += 16)
+        {
+            cv::v_float32x4 m = cv::v_max(
+                cv::v_max(cv::v_load(data + i), cv::v_load(data + i + 4)),
+                cv::v_max(cv::v_load(data + i + 8), cv::v_load(data + i + 12)));
+
+            // most blocks of a softmax output have nothing above the current k-th score
+            if (!cv::v_check_any(m > cv::v_setall_f32(out.front().second)))
+                continue;
+
+            for (size_t j = i; j < i + 16; ++j)
+                push(j);
+        }
+#endif // CV_SIMD128
+
+        for (; i < n; ++i)
+            push(i);
+
+        std::sort_heap(out.begin(), out.end(), score_desc);
+    }
+}
\ No newline at end of file
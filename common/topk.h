@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+namespace cmn
+{
+    using score_t = std::pair<size_t, float>;
+
+    /* index of the first max element, vectorized scan, <n> > 0 */
+    size_t argmax(const float * data, size_t n);
+
+    /* <out> = min(<k>, <n>) largest elements of <data> as (index, value), sorted by value descending
+    ** k = 1 - argmax(), small k - bounded min-heap with a vectorized skip of blocks below its minimum,
+    ** large k - nth_element
+    ** <out> keeps its capacity, so a thread_local vector makes it allocation-free */
+    void topk(const float * data, size_t n, size_t k, std::vector<score_t> & out);
+}
\ No newline at end of file